@@ -0,0 +1,228 @@
+#include <string.h>
+#include <math.h>
+
+#include "../../util/console_util.h"
+#include "../../util/string_util.h"
+#include "../../util/string_builder.h"
+#include "../../engine/tree/tree_to_string.h"
+#include "../../engine/tree/tree_util.h"
+#include "../../table/table.h"
+#include "../core/arith_context.h"
+#include "../core/arith_evaluation.h"
+#include "../core/interval_evaluation.h"
+#include "cmd_table.h"
+#include "cmd_bounds.h"
+
+#define COMMAND "bounds "
+
+#define STRBUILDER_STARTSIZE 10
+#define REGIONS_STARTSIZE    16
+#define MAX_EVALUATIONS      100000 // Regions with possible errors are not subdivided any further afterwards
+
+struct Region
+{
+    double from;
+    double to;
+    Interval bounds;     // Hull of results, meaningful when error is LISTENERERR_SUCCESS
+    ListenerError error; // Error that may occur within region
+    bool certain;        // Error occurs for every point of region
+};
+
+int cmd_bounds_check(const char *input)
+{
+    return begins_with(COMMAND, input);
+}
+
+// Adjacent regions of the same kind are merged into one row
+static void add_region(Vector *regions, struct Region region)
+{
+    if (vec_count(regions) > 0)
+    {
+        struct Region *last = (struct Region*)vec_get(regions, vec_count(regions) - 1);
+        if (last->error == region.error && last->certain == region.certain)
+        {
+            last->to = region.to;
+            last->bounds.lo = fmin(last->bounds.lo, region.bounds.lo);
+            last->bounds.hi = fmax(last->bounds.hi, region.bounds.hi);
+            return;
+        }
+    }
+    VEC_PUSH_ELEM(regions, struct Region, region);
+}
+
+/*
+Summary: Evaluates expression for [from, to] at once. Regions in which an error may occur, but not for every point,
+    are bisected until they are no wider than resolution. Regions that are safe or fail entirely are not subdivided.
+*/
+static void scan(const Node *expr,
+    const char *var,
+    double from,
+    double to,
+    double resolution,
+    size_t *evaluations,
+    Vector *regions)
+{
+    struct Region region = { .from = from, .to = to, .bounds = { 0, 0 }, .certain = false };
+    region.error = interval_evaluate(expr, var, (Interval){ from, to }, &region.bounds, &region.certain);
+    (*evaluations)++;
+
+    double mid = from + (to - from) / 2;
+    if (region.error != LISTENERERR_SUCCESS
+        && !region.certain
+        && to - from > resolution
+        && *evaluations < MAX_EVALUATIONS
+        && from < mid && mid < to)
+    {
+        scan(expr, var, from, mid, resolution, evaluations, regions);
+        scan(expr, var, mid, to, resolution, evaluations, regions);
+        return;
+    }
+    add_region(regions, region);
+}
+
+bool cmd_bounds_exec(char *input, __attribute__((unused)) int code)
+{
+    char *args[4];
+    size_t num_args = str_split(input + strlen(COMMAND), args, 3, ";", ";", ";");
+
+    if (num_args != 4)
+    {
+        report_error("Error: Invalid syntax. Syntax is:\n"
+               "bounds <expr> ; <from> ; <to> ; <resolution>\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < num_args; i++)
+    {
+        args[i] = strip(args[i]);
+    }
+
+    bool success = false;
+    Node *expr = NULL;
+    Node *from = NULL;
+    Node *to = NULL;
+    Node *resolution = NULL;
+    char *expr_string = NULL;
+
+    ParsingResult presult = { .error = PERR_NULL };
+    // Header shows expression as entered, constants are folded by simplification
+    if (!arith_parse_unfolded(args[0], (size_t)(args[0] - input), &presult))
+    {
+        free_result(&presult, false);
+        return false;
+    }
+
+    Vector builder = strbuilder_create(STRBUILDER_STARTSIZE);
+    strbuilder_append(&builder, " ");
+    tree_append_to_strbuilder(&builder, presult.tree, true);
+    strbuilder_append(&builder, " ");
+    expr_string = strbuilder_to_str(&builder);
+
+    expr = arith_simplify_keeping_random(&presult, args[0] - input);
+    if (expr == NULL)
+    {
+        goto exit;
+    }
+
+    const char *var = NULL;
+    bool sufficient = false;
+    list_variables(expr, 1, &var, &sufficient);
+    if (!sufficient)
+    {
+        report_error_at(args[0] - input, strlen(args[0]), "Error: More than one variable\n");
+        goto exit;
+    }
+
+    if (!arith_parse(args[1], (size_t)(args[1] - input), &from)
+        || !arith_parse(args[2], (size_t)(args[2] - input), &to)
+        || !arith_parse(args[3], (size_t)(args[3] - input), &resolution))
+    {
+        goto exit;
+    }
+
+    if (!check_if_constant(input, args[1], from)
+        || !check_if_constant(input, args[2], to)
+        || !check_if_constant(input, args[3], resolution))
+    {
+        goto exit;
+    }
+
+    double from_val = arith_evaluate(from);
+    double to_val = arith_evaluate(to);
+    double resolution_val = arith_evaluate(resolution);
+
+    if (!isfinite(from_val) || !isfinite(to_val))
+    {
+        report_error("Error: 'from' and 'to' must be finite\n");
+        goto exit;
+    }
+    if (!(resolution_val > 0))
+    {
+        report_error_at(args[3] - input, strlen(args[3]), "Error: 'resolution' must be positive\n");
+        goto exit;
+    }
+    if (from_val > to_val)
+    {
+        double temp = from_val;
+        from_val = to_val;
+        to_val = temp;
+    }
+
+    Vector regions = vec_create(sizeof(struct Region), REGIONS_STARTSIZE);
+    size_t evaluations = 0;
+    scan(expr, var, from_val, to_val, resolution_val, &evaluations, &regions);
+
+    Table *table = get_empty_table();
+
+    // Print header row only if interactive
+    if (is_interactive())
+    {
+        add_empty_cell(table);
+        if (var != NULL)
+        {
+            add_cell_fmt(table, VAR_COLOR " %s " COL_RESET, var);
+        }
+        else
+        {
+            add_empty_cell(table);
+        }
+        add_empty_cell(table);
+        add_cell(table, expr_string);
+        next_row(table);
+    }
+
+    // Displayed bounds are rounded to CONSTANT_TYPE_FMT, the computed ones are rounded outwards
+    for (size_t i = 0; i < vec_count(&regions); i++)
+    {
+        const struct Region *region = (const struct Region*)vec_get(&regions, i);
+        if (is_interactive()) add_cell_fmt(table, " %zu ", i + 1);
+        add_cell_fmt(table, " " CONSTANT_TYPE_FMT " ", region->from);
+        add_cell_fmt(table, " " CONSTANT_TYPE_FMT " ", region->to);
+        if (region->error == LISTENERERR_SUCCESS)
+        {
+            add_cell_fmt(table, " [" CONSTANT_TYPE_FMT ", " CONSTANT_TYPE_FMT "] ", region->bounds.lo, region->bounds.hi);
+        }
+        else
+        {
+            add_cell_fmt(table, " %s: %s ",
+                region->certain ? "Error" : "Possible error",
+                listenererr_to_str(region->error));
+        }
+        next_row(table);
+    }
+    vec_destroy(&regions);
+
+    set_default_alignments(table, 4,
+        (TableHAlign[]){ H_ALIGN_RIGHT, H_ALIGN_RIGHT, H_ALIGN_RIGHT, H_ALIGN_RIGHT }, NULL);
+    print_table(table);
+    free_table(table);
+
+    success = true;
+    exit:
+    free_tree(expr);
+    free(expr_string);
+    free_tree(from);
+    free_tree(to);
+    free_tree(resolution);
+    return success;
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include <stdbool.h>
+
+int cmd_bounds_check(const char *input);
+bool cmd_bounds_exec(char *input, int code);
@@ -3,6 +3,7 @@
 
 #include "../../util/string_util.h"
 #include "../../util/console_util.h"
+#include "../../util/alloc_wrappers.h"
 #include "../../engine/tree/node.h"
 #include "../../engine/tree/tree_util.h"
 #include "../../engine/parsing/tokenizer.h"
@@ -48,14 +49,10 @@ static bool do_left_checks(Node *left_n, int strlen)
             }
         }
 
-        const char *vars[MAX_MAPPED_VARS];
-        bool sufficient_buff = false;
-        size_t num_vars = list_variables(left_n, MAX_MAPPED_VARS, vars, &sufficient_buff);
-        if (!sufficient_buff)
-        {
-            report_error_at(0, strlen, "Too many function parameters. Maximum is %zu.", MAX_MAPPED_VARS);
-            return false;
-        }
+        // Children are variables, so there can't be more distinct variables than children
+        const char **vars = malloc_wrapper(num_children * sizeof(char*));
+        size_t num_vars = list_variables(left_n, num_children, vars, NULL);
+        free(vars);
         if (num_vars != num_children)
         {
             report_error_at(0, strlen, ERR_NOT_DISTINCT);
@@ -37,13 +37,22 @@ static const char *LICENSE =
     "You should have received a copy of the GNU General Public License\n"
     "along with this program.  If not, see <https://www.gnu.org/licenses/>.\n";
 
-#define NUM_COMMANDS 9
+#define NUM_COMMANDS 16
 static const char *COMMAND_TABLE[NUM_COMMANDS][2] = {
     { "<func|const> = <after>",                  "Adds function or constant" },
     { "table <expr> ; <from> ; <to> ; <step>  \n"
       "   [fold <expr> ; <init>]",               "Prints table of values" },
+    { "bounds <expr> ; <from> ; <to> ; <res>",   "Prints guaranteed bounds, subdivides regions with possible errors" },
     { "load [simplification] <path>",            "Executes commands or loads simplification ruleset in file" },
     { "clear [<func>]",                          "Clears all or one function or constant" },
+    { "set egraph on|off",                       "Simplifies by equality saturation instead of ordered rewriting" },
+    { "set parallel on|off",                     "Normalizes independent subtrees of large expressions concurrently" },
+    { "set profiler on|off",                     "Collects statistics of simplification rules" },
+    { "profile [reset]",                         "Prints or resets statistics of simplification rules" },
+    { "set reorder on|off",                      "Reorders rules of unordered rulesets by hit rate" },
+    { "set steps <n>",                           "Limits rule appliances per ruleset of a simplification" },
+    { "set timeout <ms>",                        "Limits time of a simplification, 0 for no limit" },
+    { "set compensated on|off",                  "Evaluates +, -, *, / and aggregates in double-double" },
     { "help [operators]",                        "Shows this message or a verbose list of all operators" },
     { "license",                                 "Shows information about ccalc's license" },
     { "quit",                                    "Closes application" }
@@ -110,12 +119,12 @@ static const char *OP_DESCRIPTIONS[NUM_ARITH_OPS] = {
     " Last result "
 };
 
-static const size_t PSEUDO_IND =  0; // Index of first pseudo operator ($, @, ', deriv)
-static const size_t BASIC_IND  =  4; // Index of first basic operator
-static const size_t TRIG_IND   = 22; // Index of first trigonometric function
-static const size_t MISC_IND   = 34; // Index of first misc. function
-static const size_t CONST_IND  = 52; // Index of first constant
-static const size_t LAST_IND   = 58; // Index of last constant
+static const size_t PSEUDO_IND = ARITH_OP_GROUP; // Index of first pseudo operator ($, @, ', deriv)
+static const size_t BASIC_IND  = ARITH_OP_ADD;   // Index of first basic operator
+static const size_t TRIG_IND   = ARITH_OP_SIN;   // Index of first trigonometric function
+static const size_t MISC_IND   = ARITH_OP_MAX;   // Index of first misc. function
+static const size_t CONST_IND  = ARITH_OP_PI;    // Index of first constant
+static const size_t LAST_IND   = NUM_ARITH_OPS;  // Index of last constant
 
 int cmd_help_check(const char *input)
 {
@@ -0,0 +1,46 @@
+#include <string.h>
+
+#include "../../util/console_util.h"
+#include "../../engine/transformation/rule_profiler.h"
+#include "../simplification/simplification.h"
+#include "cmd_profile.h"
+
+#define PRINT_CODE 1
+#define RESET_CODE 2
+
+#define PROFILE_COMMAND "profile"
+#define RESET_COMMAND   "profile reset"
+
+int cmd_profile_check(const char *input)
+{
+    if (strcmp(PROFILE_COMMAND, input) == 0) return PRINT_CODE;
+    if (strcmp(RESET_COMMAND, input) == 0) return RESET_CODE;
+    return false;
+}
+
+/*
+Summary: Prints or resets statistics of simplification rules
+*/
+bool cmd_profile_exec(__attribute__((unused)) char *input, int code)
+{
+    if (!simplification_is_initialized())
+    {
+        report_error("Error: No simplification loaded\n");
+        return false;
+    }
+
+    if (code == PRINT_CODE)
+    {
+        if (!profiler_is_enabled())
+        {
+            whisper("Profiler is disabled, use 'set profiler on' to collect statistics\n");
+        }
+        print_rule_statistics();
+    }
+    else
+    {
+        reset_rule_statistics();
+        whisper("Statistics reset\n");
+    }
+    return true;
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include <stdbool.h>
+
+int cmd_profile_check(const char *input);
+bool cmd_profile_exec(char *input, int code);
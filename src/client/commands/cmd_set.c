@@ -0,0 +1,116 @@
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "../../util/console_util.h"
+#include "../../util/string_util.h"
+#include "../../engine/transformation/rule_profiler.h"
+#include "../simplification/simplification.h"
+#include "../core/compensated_evaluation.h"
+#include "cmd_set.h"
+
+#define COMMAND   "set "
+#define VALUE_ON  "on"
+#define VALUE_OFF "off"
+
+// Options are process-wide switches, they are not stored in a Session
+struct Option
+{
+    const char *name;
+    void (*setter)(bool value);
+};
+
+static const size_t NUM_OPTIONS = 5;
+static const struct Option options[] = {
+    { "egraph",      set_egraph_simplification },
+    { "parallel",    set_parallel_simplification },
+    { "profiler",    profiler_set_enabled },
+    { "reorder",     profiler_set_adaptive },
+    { "compensated", set_compensated_evaluation }
+};
+
+struct NumericOption
+{
+    const char *name;
+    void (*setter)(size_t value);
+};
+
+static const size_t NUM_NUMERIC_OPTIONS = 2;
+static const struct NumericOption numeric_options[] = {
+    { "steps",   set_simplification_step_budget },
+    { "timeout", set_simplification_time_budget }
+};
+
+int cmd_set_check(const char *input)
+{
+    return begins_with(COMMAND, input);
+}
+
+// Returns: True if value is a non-negative decimal integer that fits into out_value
+static bool parse_size(const char *value, size_t *out_value)
+{
+    if (!isdigit(value[0])) return false;
+    char *end;
+    unsigned long long res = strtoull(value, &end, 10);
+    if (*end != '\0' || res > SIZE_MAX) return false;
+    *out_value = res;
+    return true;
+}
+
+/*
+Summary: Switches option on or off, syntax is "set <option> on|off".
+    Numeric options are set by "set <option> <value>".
+*/
+bool cmd_set_exec(char *input, __attribute__((unused)) int code)
+{
+    input += strlen(COMMAND);
+    char *value = strchr(input, ' ');
+    if (value == NULL)
+    {
+        report_error("Syntax: set <option> " VALUE_ON "|" VALUE_OFF "\n");
+        return false;
+    }
+    *value = '\0';
+    value++;
+
+    for (size_t i = 0; i < NUM_OPTIONS; i++)
+    {
+        if (strcmp(options[i].name, input) == 0)
+        {
+            if (strcmp(value, VALUE_ON) == 0)
+            {
+                options[i].setter(true);
+            }
+            else if (strcmp(value, VALUE_OFF) == 0)
+            {
+                options[i].setter(false);
+            }
+            else
+            {
+                report_error("Error: Value must be " VALUE_ON " or " VALUE_OFF "\n");
+                return false;
+            }
+            whisper("%s is %s\n", options[i].name, value);
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < NUM_NUMERIC_OPTIONS; i++)
+    {
+        if (strcmp(numeric_options[i].name, input) == 0)
+        {
+            size_t parsed;
+            if (!parse_size(value, &parsed))
+            {
+                report_error("Error: Value must be a non-negative integer\n");
+                return false;
+            }
+            numeric_options[i].setter(parsed);
+            whisper("%s is %zu\n", numeric_options[i].name, parsed);
+            return true;
+        }
+    }
+
+    report_error("Error: Unknown option %s\n", input);
+    return false;
+}
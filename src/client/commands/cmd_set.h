@@ -0,0 +1,5 @@
+#pragma once
+#include <stdbool.h>
+
+int cmd_set_check(const char *input);
+bool cmd_set_exec(char *input, int code);
@@ -3,12 +3,15 @@
 #include "../../util/console_util.h"
 #include "../../util/string_util.h"
 #include "../../util/string_builder.h"
+#include "../../util/alloc_wrappers.h"
 #include "../../engine/tree/tree_to_string.h"
 #include "../../engine/tree/tree_util.h"
 #include "../../table/table.h"
 #include "../core/arith_context.h"
 #include "../core/history.h"
 #include "../core/arith_evaluation.h"
+#include "../core/batch_evaluation.h"
+#include "../core/compensated_evaluation.h"
 #include "cmd_table.h"
 
 #define COMMAND      "table "
@@ -18,6 +21,7 @@
 
 #define STRBUILDER_STARTSIZE 10
 #define DOUBLE_FMT "%-.10f"
+#define VALUES_STARTSIZE 16
 
 int cmd_table_check(const char *input)
 {
@@ -34,6 +38,64 @@ bool check_if_constant(const char *offset, const char *string, const Node *node)
     return true;
 }
 
+// Evaluates expression for all values at once. False if expression contains a variable other than var.
+static bool evaluate_rows(const Node *expr,
+    size_t num_vars,
+    const char *var,
+    const Vector *values,
+    double *results,
+    ListenerError *errors)
+{
+    BatchProgram program;
+    if (!batch_compile(expr, num_vars, &var, &program)) return false;
+    batch_evaluate(&program, vec_count(values), (const double*[]){ (double*)values->buffer }, results, errors);
+    batch_free(&program);
+    return true;
+}
+
+// True if evaluation of a row failed since a derivative could not be evaluated numerically, e.g. a nested one
+static bool has_impossible_derivative(size_t num_rows, const ListenerError *errors)
+{
+    for (size_t i = 0; i < num_rows; i++)
+    {
+        if (errors[i] == LISTENERERR_IMPOSSIBLE_DERIV) return true;
+    }
+    return false;
+}
+
+/*
+Summary: Evaluates expression for each value. Derivatives are evaluated numerically, unless this fails for a row
+    (e.g. since derivatives are nested). Then expression is parsed from input again and rewritten symbolically.
+Params
+    input: Expression as typed in, prompt_len is its position within command
+    expr:  Result of arith_simplify_numeric_derivatives, is replaced when derivatives are rewritten
+    var:   Only variable of expression, NULL if it is constant
+Returns: False if expression can not be evaluated, an error is reported then
+*/
+bool table_evaluate(char *input,
+    size_t prompt_len,
+    Node **expr,
+    const char *var,
+    const Vector *values,
+    double *results,
+    ListenerError *errors)
+{
+    size_t num_vars = var != NULL ? 1 : 0;
+    if (!evaluate_rows(*expr, num_vars, var, values, results, errors))
+    {
+        report_error_at(prompt_len, strlen(input), "Error: Expression contains unbound variable\n");
+        return false;
+    }
+    if (!has_impossible_derivative(vec_count(values), errors)) return true;
+
+    free_tree(*expr);
+    *expr = NULL;
+    ParsingResult presult = { .error = PERR_NULL };
+    if (!arith_parse_raw(input, prompt_len, &presult)) return false;
+    *expr = arith_simplify(&presult, prompt_len);
+    return *expr != NULL && evaluate_rows(*expr, num_vars, var, values, results, errors);
+}
+
 bool cmd_table_exec(char *input, __attribute__((unused)) int code)
 {
     char *args[6];
@@ -59,11 +121,16 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
     Node *fold_expr = NULL;
     Node *fold_init = NULL;
     char *expr_string = NULL;
+    Vector values = vec_create(sizeof(double), VALUES_STARTSIZE);
+    double *results = NULL;
+    ListenerError *errors = NULL;
 
     ParsingResult presult = { .error = PERR_NULL };
-    if (!arith_parse_raw(args[0], (size_t)(args[0] - input), &presult))
+    // Header shows expression as entered, constants are folded by simplification
+    if (!arith_parse_unfolded(args[0], (size_t)(args[0] - input), &presult))
     {
         free_result(&presult, false);
+        vec_destroy(&values);
         return false;
     }
 
@@ -73,7 +140,8 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
     strbuilder_append(&builder, " ");
     expr_string = strbuilder_to_str(&builder);
 
-    expr = arith_simplify(&presult, args[0] - input);
+    // Derivatives are evaluated numerically for each row, which is faster than evaluating their symbolic form
+    expr = arith_simplify_numeric_derivatives(&presult, args[0] - input);
     if (expr == NULL)
     {
         goto exit;
@@ -114,6 +182,7 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
 
     // Optionally: Parse part of command after "fold"
     double fold_val = 0;
+    DoubleDouble fold_dd = dd_from_double(0);
     if (num_args == 6)
     {
         // Parse initial fold-value
@@ -135,6 +204,7 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
         if (!check_if_constant(input, args[5], fold_init)) goto exit;
 
         fold_val = arith_evaluate(fold_init);
+        fold_dd = dd_from_double(fold_val);
     }
     // - - - End of parsing of fold-construct
 
@@ -145,6 +215,20 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
         step_val *= -1;
     }
 
+    // Collect all values first, so that expression can be evaluated for all of them at once
+    for (; step_val > 0 ? start_val <= end_val : start_val >= end_val; start_val += step_val)
+    {
+        VEC_PUSH_ELEM(&values, double, start_val);
+    }
+    size_t num_rows = vec_count(&values);
+    results = malloc_wrapper(num_rows * sizeof(double));
+    errors = malloc_wrapper(num_rows * sizeof(ListenerError));
+
+    if (!table_evaluate(args[0], args[0] - input, &expr, num_vars != 0 ? var : NULL, &values, results, errors))
+    {
+        goto exit;
+    }
+
     Table *table = get_empty_table();
     
     // Print header row only if interactive
@@ -165,23 +249,29 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
     }
 
     // Loop through all values and add them to table
-    for (size_t i = 1; step_val > 0 ? start_val <= end_val : start_val >= end_val; i++)
+    for (size_t i = 0; i < num_rows; i++)
     {
-        Node *current_expr = tree_copy(expr);
-        Node *current_val = malloc_constant_node(start_val, 0);
-        replace_variable_nodes(&current_expr, current_val, var);
+        double result = results[i];
 
-        double result = 0;
-        ListenerError err = tree_reduce(current_expr, arith_op_evaluate, &result, NULL);
+        if (is_interactive()) add_cell_fmt(table, " %zu ", i + 1);
+        add_cell_fmt(table, " " DOUBLE_FMT " ", *(double*)vec_get(&values, i));
 
-        if (is_interactive()) add_cell_fmt(table, " %zu ", i);
-        add_cell_fmt(table, " " DOUBLE_FMT " ", start_val);
-
-        if (err == LISTENERERR_SUCCESS)
+        if (errors[i] == LISTENERERR_SUCCESS)
         {
             add_cell_fmt(table, " " DOUBLE_FMT " ", result);
 
-            if (num_args == 6)
+            if (num_args == 6 && get_compensated_evaluation())
+            {
+                // Intermediate result is kept in double-double, so that rounding errors don't accumulate
+                DoubleDouble bindings[2] = { fold_dd, dd_from_double(result) };
+                const char *fold_vars[2] = { FOLD_VAR_1, FOLD_VAR_2 };
+                if (dd_evaluate(fold_expr, 2, fold_vars, bindings, &fold_dd, NULL) != LISTENERERR_SUCCESS)
+                {
+                    fold_dd = dd_from_double(0);
+                }
+                fold_val = dd_to_double(fold_dd);
+            }
+            else if (num_args == 6)
             {
                 Node *current_fold = tree_copy(fold_expr);
                 Node *current_fold_x = malloc_constant_node(fold_val, 0);
@@ -196,15 +286,19 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
         }
         else
         {
-            add_cell_fmt(table, " Error ");
+            // Output of scripts keeps its format, only interactive users see the reason
+            if (is_interactive())
+            {
+                add_cell_fmt(table, " Error: %s ", listenererr_to_str(errors[i]));
+            }
+            else
+            {
+                add_cell_fmt(table, " Error ");
+            }
         }
 
-        free_tree(current_expr);
-        free_tree(current_val);
         next_row(table);
-        start_val += step_val;
     }
-
     set_default_alignments(table, 3, (TableHAlign[]){ H_ALIGN_RIGHT, H_ALIGN_RIGHT, H_ALIGN_RIGHT }, NULL);
     print_table(table);
     free_table(table);
@@ -217,6 +311,9 @@ bool cmd_table_exec(char *input, __attribute__((unused)) int code)
 
     success = true;
     exit:
+    vec_destroy(&values);
+    free(results);
+    free(errors);
     free_tree(expr);
     free(expr_string);
     free_tree(start);
@@ -1,5 +1,16 @@
 #pragma once
 #include <stdbool.h>
+#include "../../util/vector.h"
+#include "../../engine/tree/node.h"
+#include "../../engine/tree/tree_util.h"
 
 int cmd_table_check(const char *input);
 bool cmd_table_exec(char *input, int code);
+bool check_if_constant(const char *offset, const char *string, const Node *node);
+bool table_evaluate(char *input,
+    size_t prompt_len,
+    Node **expr,
+    const char *var,
+    const Vector *values,
+    double *results,
+    ListenerError *errors);
@@ -15,6 +15,9 @@
 #include "cmd_load.h"
 #include "cmd_definition.h"
 #include "cmd_table.h"
+#include "cmd_bounds.h"
+#include "cmd_set.h"
+#include "cmd_profile.h"
 
 #define COMMENT_PREFIX         '#'
 #define QUIT_COMMAND           "quit"
@@ -38,13 +41,16 @@ struct Command
     bool (*exec_handler)(char *input, int check_code);
 };
 
-static const size_t NUM_COMMANDS = 6;
+static const size_t NUM_COMMANDS = 9;
 static const struct Command commands[] = {
     { cmd_help_check,       cmd_help_exec },
     { cmd_table_check,      cmd_table_exec },
+    { cmd_bounds_check,     cmd_bounds_exec },
     { cmd_definition_check, cmd_definition_exec },
     { cmd_clear_check,      cmd_clear_exec },
     { cmd_load_check,       cmd_load_exec },
+    { cmd_set_check,        cmd_set_exec },
+    { cmd_profile_check,    cmd_profile_exec },
     /* Evaluation is last command. Its check function always returns true. */
     { cmd_evaluation_check, cmd_evaluation_exec }
 };
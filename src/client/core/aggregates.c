@@ -0,0 +1,121 @@
+#include <math.h>
+#include "aggregates.h"
+
+#define NUM_LANES      4  // Independent accumulators, so that consecutive operations don't depend on each other
+#define PAIRWISE_BLOCK 32 // Smaller sums are not split further
+
+/*
+Summary: Pairwise summation. Rounding error grows with O(log n) instead of O(n) as in naive summation.
+*/
+double aggregate_sum(const double *x, size_t n, size_t stride)
+{
+    if (n > PAIRWISE_BLOCK)
+    {
+        size_t half = n / 2;
+        return aggregate_sum(x, half, stride) + aggregate_sum(x + half * stride, n - half, stride);
+    }
+
+    double lanes[NUM_LANES] = { 0 };
+    size_t i = 0;
+    for (; i + NUM_LANES <= n; i += NUM_LANES)
+    {
+        for (size_t j = 0; j < NUM_LANES; j++) lanes[j] += x[(i + j) * stride];
+    }
+    for (; i < n; i++) lanes[i % NUM_LANES] += x[i * stride];
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+/*
+Summary: Multiplies in order of operands. Reordering doesn't improve accuracy of a product,
+    but can turn an overflow into inf * 0 = NaN.
+*/
+double aggregate_prod(const double *x, size_t n, size_t stride)
+{
+    double res = 1;
+    for (size_t i = 0; i < n; i++) res *= x[i * stride];
+    return res;
+}
+
+double aggregate_avg(const double *x, size_t n, size_t stride)
+{
+    if (n == 0) return 0;
+    return aggregate_sum(x, n, stride) / n;
+}
+
+/*
+Summary: Population variance in a single pass. Each lane accumulates count, mean and sum of squared deviations
+    by Welford's method, lanes are merged by the formula of Chan et al. Avoids cancellation of E[X^2] - E[X]^2.
+*/
+double aggregate_variance(const double *x, size_t n, size_t stride)
+{
+    if (n == 0) return NAN;
+
+    double count[NUM_LANES] = { 0 };
+    double mean[NUM_LANES] = { 0 };
+    double m2[NUM_LANES] = { 0 };
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t j = i % NUM_LANES;
+        double value = x[i * stride];
+        count[j]++;
+        double delta = value - mean[j];
+        mean[j] += delta / count[j];
+        m2[j] += delta * (value - mean[j]);
+    }
+
+    for (size_t j = 1; j < NUM_LANES; j++)
+    {
+        if (count[j] == 0) continue;
+        double total = count[0] + count[j];
+        double delta = mean[j] - mean[0];
+        mean[0] += delta * count[j] / total;
+        m2[0] += m2[j] + delta * delta * count[0] * count[j] / total;
+        count[0] = total;
+    }
+    return m2[0] / n;
+}
+
+// Like comparisons in a loop that starts with -INFINITY, NaNs are ignored
+double aggregate_max(const double *x, size_t n, size_t stride)
+{
+    double lanes[NUM_LANES] = { -INFINITY, -INFINITY, -INFINITY, -INFINITY };
+    size_t i = 0;
+    for (; i + NUM_LANES <= n; i += NUM_LANES)
+    {
+        for (size_t j = 0; j < NUM_LANES; j++)
+        {
+            double value = x[(i + j) * stride];
+            lanes[j] = value > lanes[j] ? value : lanes[j];
+        }
+    }
+    for (; i < n; i++)
+    {
+        double value = x[i * stride];
+        lanes[i % NUM_LANES] = value > lanes[i % NUM_LANES] ? value : lanes[i % NUM_LANES];
+    }
+    double res = lanes[0];
+    for (size_t j = 1; j < NUM_LANES; j++) res = lanes[j] > res ? lanes[j] : res;
+    return res;
+}
+
+double aggregate_min(const double *x, size_t n, size_t stride)
+{
+    double lanes[NUM_LANES] = { INFINITY, INFINITY, INFINITY, INFINITY };
+    size_t i = 0;
+    for (; i + NUM_LANES <= n; i += NUM_LANES)
+    {
+        for (size_t j = 0; j < NUM_LANES; j++)
+        {
+            double value = x[(i + j) * stride];
+            lanes[j] = value < lanes[j] ? value : lanes[j];
+        }
+    }
+    for (; i < n; i++)
+    {
+        double value = x[i * stride];
+        lanes[i % NUM_LANES] = value < lanes[i % NUM_LANES] ? value : lanes[i % NUM_LANES];
+    }
+    double res = lanes[0];
+    for (size_t j = 1; j < NUM_LANES; j++) res = lanes[j] < res ? lanes[j] : res;
+    return res;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <stdlib.h>
+
+/*
+Kernels of functions with dynamic arity. Element i of the n values is x[i * stride], so that they can be applied
+to a contiguous argument list as well as to a row of a batch whose arguments are stored in columns.
+*/
+
+double aggregate_sum(const double *x, size_t n, size_t stride);
+double aggregate_prod(const double *x, size_t n, size_t stride);
+double aggregate_avg(const double *x, size_t n, size_t stride);
+double aggregate_variance(const double *x, size_t n, size_t stride);
+double aggregate_min(const double *x, size_t n, size_t stride);
+double aggregate_max(const double *x, size_t n, size_t stride);
@@ -9,7 +9,9 @@
 #include "../simplification/simplification.h"
 #include "arith_context.h"
 #include "arith_evaluation.h"
+#include "compensated_evaluation.h"
 #include "history.h"
+#include "session.h"
 
 ParsingContext __g_ctx;
 LinkedList __g_composite_functions;
@@ -19,7 +21,7 @@ Summary: Sets arithmetic context stored in global variable
 */
 void init_arith_ctx()
 {
-    srand(time(NULL));
+    session_seed(session_default(), (uint64_t)time(NULL));
     __g_ctx = get_arith_ctx();
     __g_composite_functions = list_create(sizeof(RewriteRule));
 }
@@ -27,67 +29,14 @@ void init_arith_ctx()
 ParsingContext get_arith_ctx()
 {
     ParsingContext res = ctx_create();
-    if (!ctx_add_ops(&res, NUM_ARITH_OPS,
-        op_get_prefix("$", 0),
-        op_get_prefix("@", 8),
-        op_get_postfix("'", 7),
-        op_get_function("deriv", 2),
-        op_get_infix("+", 2, OP_ASSOC_LEFT),
-        op_get_infix("-", 2, OP_ASSOC_LEFT),
-        op_get_infix("*", 4, OP_ASSOC_LEFT),
-        op_get_infix("/", 3, OP_ASSOC_LEFT),
-        op_get_infix("^", 5, OP_ASSOC_RIGHT),
-        op_get_infix("C", 1, OP_ASSOC_LEFT),
-        op_get_infix("mod", 1, OP_ASSOC_LEFT),
-        op_get_prefix("+", 7),
-        op_get_prefix("-", 7),
-        op_get_postfix("!", 6),
-        op_get_postfix("%", 6),
-        op_get_function("exp", 1),
-        op_get_function("root", 2),
-        op_get_function("sqrt", 1),
-        op_get_function("log", 2),
-        op_get_function("ln", 1),
-        op_get_function("ld", 1),
-        op_get_function("lg", 1),
-        op_get_function("sin", 1),
-        op_get_function("cos", 1),
-        op_get_function("tan", 1),
-        op_get_function("asin", 1),
-        op_get_function("acos", 1),
-        op_get_function("atan", 1),
-        op_get_function("sinh", 1),
-        op_get_function("cosh", 1),
-        op_get_function("tanh", 1),
-        op_get_function("asinh", 1),
-        op_get_function("acosh", 1),
-        op_get_function("atanh", 1),
-        op_get_function("max", OP_DYNAMIC_ARITY),
-        op_get_function("min", OP_DYNAMIC_ARITY),
-        op_get_function("abs", 1),
-        op_get_function("ceil", 1),
-        op_get_function("floor", 1),
-        op_get_function("round", 1),
-        op_get_function("trunc", 1),
-        op_get_function("frac", 1),
-        op_get_function("sgn", 1),
-        op_get_function("sum", OP_DYNAMIC_ARITY),
-        op_get_function("prod", OP_DYNAMIC_ARITY),
-        op_get_function("avg", OP_DYNAMIC_ARITY),
-        op_get_function("gcd", 2),
-        op_get_function("lcm", 2),
-        op_get_function("rand", 2),
-        op_get_function("fib", 1),
-        op_get_function("gamma", 1),
-        op_get_function("var", OP_DYNAMIC_ARITY),
-        op_get_constant("pi"),
-        op_get_constant("e"),
-        op_get_constant("phi"),
-        op_get_constant("clight"),
-        op_get_constant("csound"),
-        op_get_constant("ans")))
+    for (ArithOpId id = 0; id < NUM_ARITH_OPS; id++)
     {
-        software_defect("[Arith] Inconsistent operator set.\n");
+        // Ids are assigned in order of registration, they must coincide with ArithOpId
+        const Operator *op = ctx_add_op(&res, arith_get_op(id));
+        if (op == NULL || op->id != id)
+        {
+            software_defect("[Arith] Inconsistent operator set.\n");
+        }
     }
     // Set multiplication as glue-op
     ctx_set_glue_op(&res, ctx_lookup_op(&res, "*", OP_PLACE_INFIX));
@@ -182,7 +131,7 @@ static const char *perr_to_string(ParserError perr)
     }
 }
 
-static const char *listenererr_to_str(int code)
+const char *listenererr_to_str(int code)
 {
     switch (code)
     {
@@ -236,12 +185,12 @@ bool arith_parse(char *input, size_t prompt_len, Node **out_res)
     return false;
 }
 
-/*
-Summary: Only calls parser, does not perform any substitution
-*/
-bool arith_parse_raw(char *input, size_t prompt_len, ParsingResult *out_res)
+static bool parse_with_error_report(char *input, size_t prompt_len, bool fold, ParsingResult *out_res)
 {
-    if (!parse_input(g_ctx, input, out_res))
+    bool success = fold
+        ? parse_input_folded(g_ctx, input, out_res)
+        : parse_input(g_ctx, input, out_res);
+    if (!success)
     {
         show_error_at_token(&out_res->tokens, out_res->error_token, perr_to_string(out_res->error), prompt_len);
         free_result(out_res, false);
@@ -254,15 +203,33 @@ bool arith_parse_raw(char *input, size_t prompt_len, ParsingResult *out_res)
 }
 
 /*
-Summary: Replaces user-defined functions and simplifies
-    Will call free_result on p_result!!! Don't use it afterwards.
+Summary: Only calls parser, does not perform any substitution
+    Constant subtrees are already folded, since result is simplified and evaluated afterwards.
+    In compensated mode, folding is left to simplification, since parser folds in double precision.
 */
-Node *arith_simplify(ParsingResult *p_result, size_t prompt_len)
+bool arith_parse_raw(char *input, size_t prompt_len, ParsingResult *out_res)
+{
+    return parse_with_error_report(input, prompt_len, !get_compensated_evaluation(), out_res);
+}
+
+/*
+Summary: Like arith_parse_raw, but constant subtrees are kept, so that the tree can be shown as it was entered.
+    They are folded when the result is simplified.
+*/
+bool arith_parse_unfolded(char *input, size_t prompt_len, ParsingResult *out_res)
+{
+    return parse_with_error_report(input, prompt_len, false, out_res);
+}
+
+static Node *simplify_result(ParsingResult *p_result,
+    size_t prompt_len,
+    ListenerError (*simplifier)(Node **tree, const Node **errnode))
 {
     LinkedListIterator iterator = list_get_iterator(g_composite_functions);
-    apply_ruleset_by_iterator(&p_result->tree, (Iterator*)&iterator, NULL, SIZE_MAX);
+    // Expansion of user-defined functions is not limited, a large input legitimately needs many steps
+    apply_ruleset_by_iterator(&p_result->tree, (Iterator*)&iterator, NULL, get_budget(SIZE_MAX, 0));
     const Node *errnode = NULL;
-    ListenerError l_err = simplify(&p_result->tree, &errnode);
+    ListenerError l_err = simplifier(&p_result->tree, &errnode);
     if (l_err != LISTENERERR_SUCCESS)
     {
         show_error_at_token(&p_result->tokens, get_token_index(errnode), listenererr_to_str(l_err), prompt_len);
@@ -276,3 +243,28 @@ Node *arith_simplify(ParsingResult *p_result, size_t prompt_len)
         return res;
     }
 }
+
+/*
+Summary: Replaces user-defined functions and simplifies
+    Will call free_result on p_result!!! Don't use it afterwards.
+*/
+Node *arith_simplify(ParsingResult *p_result, size_t prompt_len)
+{
+    return simplify_result(p_result, prompt_len, simplify);
+}
+
+/*
+Summary: Like arith_simplify, but derivatives are not rewritten symbolically. Used when they are evaluated numerically.
+*/
+Node *arith_simplify_numeric_derivatives(ParsingResult *p_result, size_t prompt_len)
+{
+    return simplify_result(p_result, prompt_len, simplify_keeping_derivatives);
+}
+
+/*
+Summary: Like arith_simplify, but random numbers are kept. Used when bounds of all possible results are computed.
+*/
+Node *arith_simplify_keeping_random(ParsingResult *p_result, size_t prompt_len)
+{
+    return simplify_result(p_result, prompt_len, simplify_keeping_random);
+}
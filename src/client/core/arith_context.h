@@ -5,8 +5,8 @@
 #include "../../engine/tree/node.h"
 #include "../../engine/tree/tree_util.h"
 #include "../../engine/transformation/rewrite_rule.h"
+#include "arith_evaluation.h"
 
-#define NUM_ARITH_OPS 58
 #define g_ctx (&__g_ctx)
 #define g_composite_functions (&__g_composite_functions)
 
@@ -23,4 +23,8 @@ void clear_composite_functions();
 
 bool arith_parse(char *input, size_t prompt_len, Node **out_res);
 bool arith_parse_raw(char *input, size_t prompt_len, ParsingResult *out_res);
+bool arith_parse_unfolded(char *input, size_t prompt_len, ParsingResult *out_res);
 Node *arith_simplify(ParsingResult *p_result, size_t prompt_len);
+Node *arith_simplify_numeric_derivatives(ParsingResult *p_result, size_t prompt_len);
+Node *arith_simplify_keeping_random(ParsingResult *p_result, size_t prompt_len);
+const char *listenererr_to_str(int code);
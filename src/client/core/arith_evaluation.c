@@ -3,29 +3,93 @@
 #include <time.h>
 #include <float.h>
 #include <math.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "../../engine/tree/tree_util.h"
 #include "../../util/console_util.h"
 #include "history.h"
+#include "session.h"
+#include "aggregates.h"
 #include "arith_evaluation.h"
 #include "arith_context.h"
 
-static double variance(const double *args, size_t num_args)
+#define FIB_MAX_EXACT     92   // Largest n whose Fibonacci number fits into int64
+#define FIB_MAX           1476 // Largest n whose Fibonacci number fits into a double
+#define FACTORIAL_MAX     170  // Largest n whose factorial fits into a double
+#define BINOMIAL_MAX_LOOP 64   // For smaller k, C(n, k) is computed as product of k fractions
+
+static double factorials[FACTORIAL_MAX + 1];
+static pthread_once_t factorials_once = PTHREAD_ONCE_INIT;
+
+// Accumulated in extended precision, so that each entry is rounded only once
+static void init_factorials()
 {
-    double u = 0;
-    for (size_t i = 0; i < num_args; i++)
+    long double res = 1;
+    factorials[0] = 1;
+    for (size_t i = 1; i <= FACTORIAL_MAX; i++)
     {
-        u += args[i];
+        res *= i;
+        factorials[i] = (double)res;
     }
-    u /= num_args;
+}
 
-    double res = 0;
-    for (size_t i = 0; i < num_args; i++)
+/*
+Summary: Factorial of integers is looked up, other numbers are mapped to gamma(x + 1)
+*/
+static double factorial(double x)
+{
+    if (isinf(x)) return INFINITY;
+    if (x != trunc(x)) return tgamma(x + 1);
+    if (x <= 1) return 1;
+    if (x > FACTORIAL_MAX) return INFINITY;
+    pthread_once(&factorials_once, init_factorials);
+    return factorials[(size_t)x];
+}
+
+// True if x is an integer that is exactly representable as int64
+static bool to_int64(double x, int64_t *out)
+{
+    if (x != trunc(x) || x < -9223372036854775808.0 || x >= 9223372036854775808.0) return false;
+    *out = (int64_t)x;
+    return true;
+}
+
+static uint64_t magnitude(int64_t x)
+{
+    return x < 0 ? -(uint64_t)x : (uint64_t)x;
+}
+
+/*
+Summary: Binary GCD, needs O(log(a) + log(b)) shifts and subtractions
+*/
+static uint64_t binary_gcd(uint64_t a, uint64_t b)
+{
+    if (a == 0) return b;
+    if (b == 0) return a;
+
+    int shift = 0;
+    while (((a | b) & 1) == 0)
     {
-        res += pow(args[i] - u, 2);
+        a >>= 1;
+        b >>= 1;
+        shift++;
     }
+    while ((a & 1) == 0) a >>= 1;
+
+    do
+    {
+        while ((b & 1) == 0) b >>= 1;
+        if (a > b)
+        {
+            uint64_t temp = a;
+            a = b;
+            b = temp;
+        }
+        b -= a;
+    } while (b != 0);
 
-    return res / num_args;
+    return a << shift;
 }
 
 static double euclid(double a, double b)
@@ -33,25 +97,69 @@ static double euclid(double a, double b)
     a = fabs(trunc(a));
     b = fabs(trunc(b));
 
-    if (a == 0)
+    int64_t ia, ib;
+    if (to_int64(a, &ia) && to_int64(b, &ib))
     {
-        return b;
+        return (double)binary_gcd((uint64_t)ia, (uint64_t)ib);
     }
-    else
+
+    // Beyond int64, every double is an even integer. Remainders still reduce operands quickly.
+    if (!isfinite(a) || !isfinite(b)) return NAN;
+    while (b != 0)
     {
-        while (b != 0)
-        {
-            if (a > b)
-            {
-                a = a - b;
-            }
-            else
-            {
-                b = b - a;
-            }
-        }
-        return a;
+        double temp = fmod(a, b);
+        a = b;
+        b = temp;
+    }
+    return a;
+}
+
+static double lcm(double a, double b)
+{
+    int64_t ia, ib;
+    if (to_int64(trunc(a), &ia) && to_int64(trunc(b), &ib))
+    {
+        uint64_t ua = magnitude(ia);
+        uint64_t ub = magnitude(ib);
+        if (ua == 0 || ub == 0) return 0;
+        uint64_t factor = ua / binary_gcd(ua, ub);
+        if (factor <= UINT64_MAX / ub) return (double)(factor * ub);
+    }
+    return fabs(trunc(a) * trunc(b)) / euclid(a, b);
+}
+
+static double modulo(double a, double b)
+{
+    int64_t ia, ib;
+    if (to_int64(a, &ia) && to_int64(b, &ib) && ib != 0)
+    {
+        // INT64_MIN % -1 overflows
+        if (ib == -1) return a < 0 ? -0.0 : 0;
+        // Sign of result is the one of the dividend, like fmod
+        int64_t res = ia % ib;
+        return res == 0 && ia < 0 ? -0.0 : (double)res;
+    }
+    return fmod(a, b);
+}
+
+/*
+Summary: Multiplicative formula in integers. After i steps, res is C(n - k + i, i).
+    Factors are divided by their gcd beforehand, so that res * (n - k + i) / i is exact.
+Returns: False if an intermediate result overflows
+*/
+static bool binomial_int(uint64_t n, uint64_t k, uint64_t *out)
+{
+    uint64_t res = 1;
+    for (uint64_t i = 1; i <= k; i++)
+    {
+        uint64_t divisor = i / binary_gcd(res, i);
+        uint64_t factor = (n - k + i) / divisor;
+        res = res / (i / divisor);
+        if (res > UINT64_MAX / factor) return false;
+        res *= factor;
     }
+    *out = res;
+    return true;
 }
 
 static double binomial(double n, double k)
@@ -59,28 +167,91 @@ static double binomial(double n, double k)
     n = fabs(trunc(n));
     k = fabs(trunc(k));
 
-    if (k == 0) return 1;
+    if (k > n) return 0;
     if ((2 * k) > n) k = n - k;
-    
-    double res = 1;
-    for (double i = 1; i <= k; i++)
+
+    int64_t in, ik;
+    uint64_t res;
+    if (to_int64(n, &in) && to_int64(k, &ik) && binomial_int(in, ik, &res))
     {
-        res = (res * (n - k + i)) / i;
+        return (double)res;
     }
-    
-    return res;
+
+    if (k <= BINOMIAL_MAX_LOOP)
+    {
+        double res = 1;
+        for (double i = 1; i <= k; i++)
+        {
+            res = (res * (n - k + i)) / i;
+        }
+        return res;
+    }
+
+    // Result is an integer, rounding removes error of division or logarithms when it is small enough
+    if (n <= FACTORIAL_MAX)
+    {
+        return round(factorial(n) / (factorial(k) * factorial(n - k)));
+    }
+    return round(exp(lgamma(n + 1) - lgamma(k + 1) - lgamma(n - k + 1)));
 }
 
-static long fib(long n)
+/*
+Summary: Fast doubling, i.e. F(2m) = F(m) * (2F(m+1) - F(m)) and F(2m+1) = F(m)^2 + F(m+1)^2.
+    Needs O(log n) steps. Computed exactly in integers as long as result fits into int64.
+*/
+static double fib(unsigned long n)
 {
-    if (n == 0) return 0;
-    if (n == 1) return 1;
-    if (n == -1) return 1;
-    return fib(n - 1) + fib(n - 2); 
+    if (n > FIB_MAX) return INFINITY;
+
+    int bit = 0;
+    while ((n >> bit) > 1) bit++;
+
+    if (n <= FIB_MAX_EXACT)
+    {
+        // F(m+1) of last step is F(93) at most, which still fits into uint64
+        uint64_t a = 0; // F(m)
+        uint64_t b = 1; // F(m+1)
+        for (; bit >= 0; bit--)
+        {
+            uint64_t c = a * (2 * b - a);
+            uint64_t d = a * a + b * b;
+            if ((n >> bit) & 1)
+            {
+                a = d;
+                b = c + d;
+            }
+            else
+            {
+                a = c;
+                b = d;
+            }
+        }
+        return (double)a;
+    }
+
+    double a = 0;
+    double b = 1;
+    for (; bit >= 0; bit--)
+    {
+        double c = a * (2 * b - a);
+        double d = a * a + b * b;
+        if ((n >> bit) & 1)
+        {
+            a = d;
+            b = c + d;
+        }
+        else
+        {
+            a = c;
+            b = d;
+        }
+    }
+    return a;
 }
 
 static double fibonacci(double n)
 {
+    if (fabs(n) > FIB_MAX) n = n < 0 ? -FIB_MAX - 1 : FIB_MAX + 1;
     long l = (long)n;
     if (l < 0) // Generalization to negative numbers
     {
@@ -108,274 +279,224 @@ static double random_between(double min, double max)
     max = trunc(max);
     long diff = (long)(max - min);
     if (diff < 1) return -1;
-    return rand() % diff + min;
+    return session_random_below(session_current(), (uint64_t)diff) + min;
 }
 
-ListenerError arith_op_evaluate(const Operator *op, size_t num_args, const double *args, double *out)
+// Defines evaluation of an operator whose result is an expression of its operands that can not fail
+#define EVALUATION(name, expr)\
+    static ListenerError name(__attribute__((unused)) size_t num_args,\
+        __attribute__((unused)) const double *args,\
+        double *out)\
+    {\
+        *out = (expr);\
+        return LISTENERERR_SUCCESS;\
+    }
+
+EVALUATION(eval_identity,  args[0])
+EVALUATION(eval_add,       args[0] + args[1])
+EVALUATION(eval_sub,       args[0] - args[1])
+EVALUATION(eval_mul,       args[0] * args[1])
+EVALUATION(eval_binomial,  binomial(args[0], args[1]))
+EVALUATION(eval_mod,       modulo(args[0], args[1]))
+EVALUATION(eval_neg,       -args[0])
+EVALUATION(eval_factorial, factorial(args[0]))
+EVALUATION(eval_percent,   args[0] / 100)
+EVALUATION(eval_exp,       exp(args[0]))
+EVALUATION(eval_log,       log(args[0]) / log(args[1]))
+EVALUATION(eval_ln,        log(args[0]))
+EVALUATION(eval_ld,        log2(args[0]))
+EVALUATION(eval_lg,        log10(args[0]))
+EVALUATION(eval_sin,       sin(args[0]))
+EVALUATION(eval_cos,       cos(args[0]))
+EVALUATION(eval_tan,       tan(args[0]))
+EVALUATION(eval_asin,      asin(args[0]))
+EVALUATION(eval_acos,      acos(args[0]))
+EVALUATION(eval_atan,      atan(args[0]))
+EVALUATION(eval_sinh,      sinh(args[0]))
+EVALUATION(eval_cosh,      cosh(args[0]))
+EVALUATION(eval_tanh,      tanh(args[0]))
+EVALUATION(eval_asinh,     asinh(args[0]))
+EVALUATION(eval_acosh,     acosh(args[0]))
+EVALUATION(eval_atanh,     atanh(args[0]))
+EVALUATION(eval_max,       aggregate_max(args, num_args, 1))
+EVALUATION(eval_min,       aggregate_min(args, num_args, 1))
+EVALUATION(eval_abs,       fabs(args[0]))
+EVALUATION(eval_ceil,      ceil(args[0]))
+EVALUATION(eval_floor,     floor(args[0]))
+EVALUATION(eval_round,     round(args[0]))
+EVALUATION(eval_trunc,     trunc(args[0]))
+EVALUATION(eval_frac,      args[0] - floor(args[0]))
+EVALUATION(eval_sgn,       args[0] < 0 ? -1 : (args[0] > 0) ? 1 : 0)
+EVALUATION(eval_sum,       aggregate_sum(args, num_args, 1))
+EVALUATION(eval_prod,      aggregate_prod(args, num_args, 1))
+EVALUATION(eval_avg,       aggregate_avg(args, num_args, 1))
+EVALUATION(eval_gcd,       euclid(args[0], args[1]))
+EVALUATION(eval_lcm,       lcm(args[0], args[1]))
+EVALUATION(eval_rand,      random_between(args[0], args[1]))
+EVALUATION(eval_fib,       fibonacci(args[0]))
+EVALUATION(eval_gamma,     tgamma(args[0]))
+EVALUATION(eval_var,       aggregate_variance(args, num_args, 1))
+EVALUATION(eval_pi,        3.14159265359)
+EVALUATION(eval_e,         2.71828182846)
+EVALUATION(eval_phi,       1.61803398874)
+EVALUATION(eval_clight,    299792458)
+EVALUATION(eval_csound,    343.2)
+
+static ListenerError eval_history(__attribute__((unused)) size_t num_args, const double *args, double *out)
 {
-    switch (op->id)
+    if (history_get((int)args[0], out))
     {
-        case 0: // $x
-            *out = args[0];
-            return LISTENERERR_SUCCESS;
-        case 1: // @x
-        {
-            bool res = history_get((int)args[0], out);
-            if (res)
-            {
-                return LISTENERERR_SUCCESS;
-            }
-            else
-            {
-                return LISTENERERR_HISTORY_NOT_SET;
-            }
-        }
-        case 2: // deriv(x, y)
-        case 3: // x'
-            return LISTENERERR_IMPOSSIBLE_DERIV;
-        case 4: // x+y
-            *out = args[0] + args[1];
-            return LISTENERERR_SUCCESS;
-        case 5: // x-y
-            *out = args[0] - args[1];
-            return LISTENERERR_SUCCESS;
-        case 6: // x*y
-            *out = args[0] * args[1];
-            return LISTENERERR_SUCCESS;
-        case 7: // x/y
-            if (args[1] != 0)
-            {
-                *out = args[0] / args[1];
-                return LISTENERERR_SUCCESS;
-            }
-            else
-            {
-                return LISTENERERR_DIVISION_BY_ZERO;
-            }
-        case 8: // x^y
-            if (args[0] == 0 && args[1] <= 0) return LISTENERERR_DIVISION_BY_ZERO;
-            if (args[0] < 0 && args[1] < 1) return LISTENERERR_COMPLEX_SOLUTION;
-            *out = pow(args[0], args[1]);
-            return LISTENERERR_SUCCESS;
-        case 9: // x C y
-            *out = binomial(args[0], args[1]);
-            return LISTENERERR_SUCCESS;
-        case 10: // x mod y
-            *out = fmod(args[0], args[1]);
-            return LISTENERERR_SUCCESS;
-        case 11: // +x
-            *out = args[0];
-            return LISTENERERR_SUCCESS;
-        case 12: // -x
-            *out = -args[0];
-            return LISTENERERR_SUCCESS;
-        case 13: // x!
-        {
-            if (isinf(args[0]))
-            {
-                *out = INFINITY;
-            }
-            else
-            {
-                double res = 1;
-                for (double i = trunc(args[0]); i > 1; i--)
-                {
-                    res *= i;
-                }
-                *out = res;
-            }
-            return LISTENERERR_SUCCESS;
-        }
-        case 14: // x%
-            *out = args[0] / 100;
-            return LISTENERERR_SUCCESS;
-        case 15: // exp(x)
-            *out = exp(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 16: // root(x, n)
-            if (args[0] >= 0)
-            {
-                *out = pow(args[0], 1 / args[1]);
-                return LISTENERERR_SUCCESS;
-            }
-            else
-            {
-                return LISTENERERR_COMPLEX_SOLUTION;
-            }
-        case 17: // sqrt(x)
-            if (args[0] >= 0)
-            {
-                *out = sqrt(args[0]);
-                return LISTENERERR_SUCCESS;
-            }
-            else
-            {
-                return LISTENERERR_COMPLEX_SOLUTION;
-            }
-        case 18: // log(x, n)
-            *out = log(args[0]) / log(args[1]);
-            return LISTENERERR_SUCCESS;
-        case 19: // ln(x)
-            *out = log(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 20: // ld(x)
-            *out = log2(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 21: // log(x)
-            *out = log10(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 22: // sin(x)
-            *out = sin(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 23: // cos(x)
-            *out = cos(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 24: // tan(x)
-            *out = tan(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 25: // asin(x)
-            *out = asin(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 26: // acos(x)
-            *out = acos(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 27: // atan(x)
-            *out = atan(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 28: // sinh(x)
-            *out = sinh(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 29: // cosh(x)
-            *out = cosh(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 30: // tanh(x)
-            *out = tanh(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 31: // asinh(x)
-            *out = asinh(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 32: // acosh(x)
-            *out = acosh(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 33: // atanh(x)
-            *out = atanh(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 34: // max(x, y, ...)
-        {
-            double res = -INFINITY;
-            for (size_t i = 0; i < num_args; i++)
-            {
-                double child_val = args[i];
-                if (child_val > res) res = child_val;
-            }
-            *out = res;
-            return LISTENERERR_SUCCESS;
-        }
-        case 35: // min(x, y, ...)
-        {
-            double res = INFINITY;
-            for (size_t i = 0; i < num_args; i++)
-            {
-                double child_val = args[i];
-                if (child_val < res) res = child_val;
-            }
-            *out = res;
-            return LISTENERERR_SUCCESS;
-        }
-        case 36: // abs(x)
-            *out = fabs(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 37: // ceil(x)
-            *out = ceil(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 38: // floor(x)
-            *out = floor(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 39: // round(x)
-            *out = round(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 40: // trunc(x)
-            *out = trunc(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 41: // frac(x)
-            *out = args[0] - floor(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 42: // sgn(x)
-            *out = args[0] < 0 ? -1 : (args[0] > 0) ? 1 : 0;
-            return LISTENERERR_SUCCESS;
-        case 43: // sum(x, y, ...)
-        {
-            double res = 0;
-            for (size_t i = 0; i < num_args; i++) res += args[i];
-            *out = res;
-            return LISTENERERR_SUCCESS;
-        }
-        case 44: // prod(x, y, ...)
-        {
-            double res = 1;
-            for (size_t i = 0; i < num_args; i++) res *= args[i];
-            *out = res;
-            return LISTENERERR_SUCCESS;
-        }
-        case 45: // avg(x, y, ...)
-        {
-            if (num_args == 0)
-            {
-                *out = 0;
-                return LISTENERERR_SUCCESS;
-            }
-            double res = 0;
-            for (size_t i = 0; i < num_args; i++) res += args[i];
-            *out = res / num_args;
-            return LISTENERERR_SUCCESS;
-        }
-        case 46: // gcd(x, y)
-            *out = euclid(args[0], args[1]);
-            return LISTENERERR_SUCCESS;
-        case 47: // lcm(x, y)
-            *out = fabs(trunc(args[0]) * trunc(args[1])) / euclid(args[0], args[1]);
-            return LISTENERERR_SUCCESS;
-        case 48: // rand(x, y)
-            *out = random_between(args[0], args[1]);
-            return LISTENERERR_SUCCESS;
-        case 49: // fib(x)
-            *out = fibonacci(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 50: // gamma(x)
-            *out = tgamma(args[0]);
-            return LISTENERERR_SUCCESS;
-        case 51:
-            *out = variance(args, num_args);
-            return LISTENERERR_SUCCESS;
-        case 52: // pi
-            *out = 3.14159265359;
-            return LISTENERERR_SUCCESS;
-        case 53: // e
-            *out = 2.71828182846;
-            return LISTENERERR_SUCCESS;
-        case 54: // phi
-            *out = 1.61803398874;
-            return LISTENERERR_SUCCESS;
-        case 55: // clight (m/s)
-            *out = 299792458;
-            return LISTENERERR_SUCCESS;
-        case 56: // csound (m/s)
-            *out = 343.2;
-            return LISTENERERR_SUCCESS;
-        case 57: // ans
-        {
-            bool res = history_get(0, out);
-            if (res)
-            {
-                return LISTENERERR_SUCCESS;
-            }
-            else
-            {
-                return LISTENERERR_HISTORY_NOT_SET;
-            }
-        }
+        return LISTENERERR_SUCCESS;
     }
-    return LISTENERERR_UNKNOWN_OP;
+    else
+    {
+        return LISTENERERR_HISTORY_NOT_SET;
+    }
+}
+
+static ListenerError eval_ans(__attribute__((unused)) size_t num_args,
+    __attribute__((unused)) const double *args,
+    double *out)
+{
+    if (history_get(0, out))
+    {
+        return LISTENERERR_SUCCESS;
+    }
+    else
+    {
+        return LISTENERERR_HISTORY_NOT_SET;
+    }
+}
+
+// Derivatives are replaced by simplification, remaining ones can not be evaluated
+static ListenerError eval_deriv(__attribute__((unused)) size_t num_args,
+    __attribute__((unused)) const double *args,
+    __attribute__((unused)) double *out)
+{
+    return LISTENERERR_IMPOSSIBLE_DERIV;
+}
+
+static ListenerError eval_div(__attribute__((unused)) size_t num_args, const double *args, double *out)
+{
+    if (args[1] != 0)
+    {
+        *out = args[0] / args[1];
+        return LISTENERERR_SUCCESS;
+    }
+    else
+    {
+        return LISTENERERR_DIVISION_BY_ZERO;
+    }
+}
+
+static ListenerError eval_pow(__attribute__((unused)) size_t num_args, const double *args, double *out)
+{
+    if (args[0] == 0 && args[1] <= 0) return LISTENERERR_DIVISION_BY_ZERO;
+    if (args[0] < 0 && args[1] < 1) return LISTENERERR_COMPLEX_SOLUTION;
+    *out = pow(args[0], args[1]);
+    return LISTENERERR_SUCCESS;
+}
+
+static ListenerError eval_root(__attribute__((unused)) size_t num_args, const double *args, double *out)
+{
+    if (args[0] >= 0)
+    {
+        *out = pow(args[0], 1 / args[1]);
+        return LISTENERERR_SUCCESS;
+    }
+    else
+    {
+        return LISTENERERR_COMPLEX_SOLUTION;
+    }
+}
+
+static ListenerError eval_sqrt(__attribute__((unused)) size_t num_args, const double *args, double *out)
+{
+    if (args[0] >= 0)
+    {
+        *out = sqrt(args[0]);
+        return LISTENERERR_SUCCESS;
+    }
+    else
+    {
+        return LISTENERERR_COMPLEX_SOLUTION;
+    }
+}
+
+// Entries are indexed by ArithOpId, which is the id of the operator in the arithmetic context
+static const OpDescriptor ARITH_OPS[NUM_ARITH_OPS] = {
+    [ARITH_OP_GROUP]      = { "$",      OP_PLACE_PREFIX,   1,                0, OP_ASSOC_LEFT,  eval_identity,  true  },
+    [ARITH_OP_HISTORY]    = { "@",      OP_PLACE_PREFIX,   1,                8, OP_ASSOC_LEFT,  eval_history,   false },
+    [ARITH_OP_DERIV_POST] = { "'",      OP_PLACE_POSTFIX,  1,                7, OP_ASSOC_LEFT,  eval_deriv,     false },
+    [ARITH_OP_DERIV]      = { "deriv",  OP_PLACE_FUNCTION, 2,                0, OP_ASSOC_LEFT,  eval_deriv,     false },
+    [ARITH_OP_ADD]        = { "+",      OP_PLACE_INFIX,    2,                2, OP_ASSOC_LEFT,  eval_add,       true  },
+    [ARITH_OP_SUB]        = { "-",      OP_PLACE_INFIX,    2,                2, OP_ASSOC_LEFT,  eval_sub,       true  },
+    [ARITH_OP_MUL]        = { "*",      OP_PLACE_INFIX,    2,                4, OP_ASSOC_LEFT,  eval_mul,       true  },
+    [ARITH_OP_DIV]        = { "/",      OP_PLACE_INFIX,    2,                3, OP_ASSOC_LEFT,  eval_div,       true  },
+    [ARITH_OP_POW]        = { "^",      OP_PLACE_INFIX,    2,                5, OP_ASSOC_RIGHT, eval_pow,       true  },
+    [ARITH_OP_BINOMIAL]   = { "C",      OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT,  eval_binomial,  true  },
+    [ARITH_OP_MOD]        = { "mod",    OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT,  eval_mod,       true  },
+    [ARITH_OP_PLUS]       = { "+",      OP_PLACE_PREFIX,   1,                7, OP_ASSOC_LEFT,  eval_identity,  true  },
+    [ARITH_OP_NEG]        = { "-",      OP_PLACE_PREFIX,   1,                7, OP_ASSOC_LEFT,  eval_neg,       true  },
+    [ARITH_OP_FACTORIAL]  = { "!",      OP_PLACE_POSTFIX,  1,                6, OP_ASSOC_LEFT,  eval_factorial, true  },
+    [ARITH_OP_PERCENT]    = { "%",      OP_PLACE_POSTFIX,  1,                6, OP_ASSOC_LEFT,  eval_percent,   true  },
+    [ARITH_OP_EXP]        = { "exp",    OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_exp,       true  },
+    [ARITH_OP_ROOT]       = { "root",   OP_PLACE_FUNCTION, 2,                0, OP_ASSOC_LEFT,  eval_root,      true  },
+    [ARITH_OP_SQRT]       = { "sqrt",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_sqrt,      true  },
+    [ARITH_OP_LOG]        = { "log",    OP_PLACE_FUNCTION, 2,                0, OP_ASSOC_LEFT,  eval_log,       true  },
+    [ARITH_OP_LN]         = { "ln",     OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_ln,        true  },
+    [ARITH_OP_LD]         = { "ld",     OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_ld,        true  },
+    [ARITH_OP_LG]         = { "lg",     OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_lg,        true  },
+    [ARITH_OP_SIN]        = { "sin",    OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_sin,       true  },
+    [ARITH_OP_COS]        = { "cos",    OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_cos,       true  },
+    [ARITH_OP_TAN]        = { "tan",    OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_tan,       true  },
+    [ARITH_OP_ASIN]       = { "asin",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_asin,      true  },
+    [ARITH_OP_ACOS]       = { "acos",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_acos,      true  },
+    [ARITH_OP_ATAN]       = { "atan",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_atan,      true  },
+    [ARITH_OP_SINH]       = { "sinh",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_sinh,      true  },
+    [ARITH_OP_COSH]       = { "cosh",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_cosh,      true  },
+    [ARITH_OP_TANH]       = { "tanh",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_tanh,      true  },
+    [ARITH_OP_ASINH]      = { "asinh",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_asinh,     true  },
+    [ARITH_OP_ACOSH]      = { "acosh",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_acosh,     true  },
+    [ARITH_OP_ATANH]      = { "atanh",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_atanh,     true  },
+    [ARITH_OP_MAX]        = { "max",    OP_PLACE_FUNCTION, OP_DYNAMIC_ARITY, 0, OP_ASSOC_LEFT,  eval_max,       true  },
+    [ARITH_OP_MIN]        = { "min",    OP_PLACE_FUNCTION, OP_DYNAMIC_ARITY, 0, OP_ASSOC_LEFT,  eval_min,       true  },
+    [ARITH_OP_ABS]        = { "abs",    OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_abs,       true  },
+    [ARITH_OP_CEIL]       = { "ceil",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_ceil,      true  },
+    [ARITH_OP_FLOOR]      = { "floor",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_floor,     true  },
+    [ARITH_OP_ROUND]      = { "round",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_round,     true  },
+    [ARITH_OP_TRUNC]      = { "trunc",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_trunc,     true  },
+    [ARITH_OP_FRAC]       = { "frac",   OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_frac,      true  },
+    [ARITH_OP_SGN]        = { "sgn",    OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_sgn,       true  },
+    [ARITH_OP_SUM]        = { "sum",    OP_PLACE_FUNCTION, OP_DYNAMIC_ARITY, 0, OP_ASSOC_LEFT,  eval_sum,       true  },
+    [ARITH_OP_PROD]       = { "prod",   OP_PLACE_FUNCTION, OP_DYNAMIC_ARITY, 0, OP_ASSOC_LEFT,  eval_prod,      true  },
+    [ARITH_OP_AVG]        = { "avg",    OP_PLACE_FUNCTION, OP_DYNAMIC_ARITY, 0, OP_ASSOC_LEFT,  eval_avg,       true  },
+    [ARITH_OP_GCD]        = { "gcd",    OP_PLACE_FUNCTION, 2,                0, OP_ASSOC_LEFT,  eval_gcd,       true  },
+    [ARITH_OP_LCM]        = { "lcm",    OP_PLACE_FUNCTION, 2,                0, OP_ASSOC_LEFT,  eval_lcm,       true  },
+    [ARITH_OP_RAND]       = { "rand",   OP_PLACE_FUNCTION, 2,                0, OP_ASSOC_LEFT,  eval_rand,      false },
+    [ARITH_OP_FIB]        = { "fib",    OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_fib,       true  },
+    [ARITH_OP_GAMMA]      = { "gamma",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT,  eval_gamma,     true  },
+    [ARITH_OP_VAR]        = { "var",    OP_PLACE_FUNCTION, OP_DYNAMIC_ARITY, 0, OP_ASSOC_LEFT,  eval_var,       true  },
+    [ARITH_OP_PI]         = { "pi",     OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT,  eval_pi,        true  },
+    [ARITH_OP_E]          = { "e",      OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT,  eval_e,         true  },
+    [ARITH_OP_PHI]        = { "phi",    OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT,  eval_phi,       true  },
+    [ARITH_OP_CLIGHT]     = { "clight", OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT,  eval_clight,    true  },
+    [ARITH_OP_CSOUND]     = { "csound", OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT,  eval_csound,    true  },
+    [ARITH_OP_ANS]        = { "ans",    OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT,  eval_ans,       false },
+};
+
+Operator arith_get_op(ArithOpId id)
+{
+    return op_from_descriptor(&ARITH_OPS[id]);
+}
+
+/*
+Summary: Listener for tree_reduce, evaluation is dispatched to function of operator
+*/
+ListenerError arith_op_evaluate(const Operator *op, size_t num_args, const double *args, double *out)
+{
+    if (op->evaluate == NULL) return LISTENERERR_UNKNOWN_OP;
+    return op->evaluate(num_args, args, out);
 }
 
 double arith_evaluate(const Node *tree)
@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include "../../engine/tree/operator.h"
 #include "../../engine/tree/node.h"
+#include "../../engine/tree/tree_util.h"
 
 #define LISTENERERR_HISTORY_NOT_SET   1
 #define LISTENERERR_IMPOSSIBLE_DERIV  2
@@ -11,5 +12,70 @@
 #define LISTENERERR_DIVISION_BY_ZERO  6
 #define LISTENERERR_COMPLEX_SOLUTION  7
 
+// Ids of built-in operators in arithmetic context, in order of registration
+typedef enum
+{
+    ARITH_OP_GROUP,
+    ARITH_OP_HISTORY,
+    ARITH_OP_DERIV_POST,
+    ARITH_OP_DERIV,
+    ARITH_OP_ADD,
+    ARITH_OP_SUB,
+    ARITH_OP_MUL,
+    ARITH_OP_DIV,
+    ARITH_OP_POW,
+    ARITH_OP_BINOMIAL,
+    ARITH_OP_MOD,
+    ARITH_OP_PLUS,
+    ARITH_OP_NEG,
+    ARITH_OP_FACTORIAL,
+    ARITH_OP_PERCENT,
+    ARITH_OP_EXP,
+    ARITH_OP_ROOT,
+    ARITH_OP_SQRT,
+    ARITH_OP_LOG,
+    ARITH_OP_LN,
+    ARITH_OP_LD,
+    ARITH_OP_LG,
+    ARITH_OP_SIN,
+    ARITH_OP_COS,
+    ARITH_OP_TAN,
+    ARITH_OP_ASIN,
+    ARITH_OP_ACOS,
+    ARITH_OP_ATAN,
+    ARITH_OP_SINH,
+    ARITH_OP_COSH,
+    ARITH_OP_TANH,
+    ARITH_OP_ASINH,
+    ARITH_OP_ACOSH,
+    ARITH_OP_ATANH,
+    ARITH_OP_MAX,
+    ARITH_OP_MIN,
+    ARITH_OP_ABS,
+    ARITH_OP_CEIL,
+    ARITH_OP_FLOOR,
+    ARITH_OP_ROUND,
+    ARITH_OP_TRUNC,
+    ARITH_OP_FRAC,
+    ARITH_OP_SGN,
+    ARITH_OP_SUM,
+    ARITH_OP_PROD,
+    ARITH_OP_AVG,
+    ARITH_OP_GCD,
+    ARITH_OP_LCM,
+    ARITH_OP_RAND,
+    ARITH_OP_FIB,
+    ARITH_OP_GAMMA,
+    ARITH_OP_VAR,
+    ARITH_OP_PI,
+    ARITH_OP_E,
+    ARITH_OP_PHI,
+    ARITH_OP_CLIGHT,
+    ARITH_OP_CSOUND,
+    ARITH_OP_ANS,
+    NUM_ARITH_OPS
+} ArithOpId;
+
+Operator arith_get_op(ArithOpId id);
 ListenerError arith_op_evaluate(const Operator *op, size_t num_args, const double *args, double *out);
 double arith_evaluate(const Node *node);
@@ -0,0 +1,524 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../util/alloc_wrappers.h"
+#include "batch_evaluation.h"
+#include "arith_evaluation.h"
+#include "aggregates.h"
+#include "dual_evaluation.h"
+
+#define BATCH_BLOCK_SIZE 256 // Rows that are evaluated at once, intermediate columns of a block stay in cache
+
+static bool is_bound(const Node *tree, size_t num_vars, const char **vars)
+{
+    switch (get_type(tree))
+    {
+        case NTYPE_CONSTANT:
+            return true;
+
+        case NTYPE_VARIABLE:
+            for (size_t i = 0; i < num_vars; i++)
+            {
+                if (strcmp(get_var_name(tree), vars[i]) == 0) return true;
+            }
+            return false;
+
+        case NTYPE_OPERATOR:
+            for (size_t i = 0; i < get_num_children(tree); i++)
+            {
+                if (!is_bound(get_child(tree, i), num_vars, vars)) return false;
+            }
+            return true;
+    }
+    return false;
+}
+
+// Entry of hash table of subtrees, a subtree that occurs more than once is evaluated once and stored in a let-slot
+struct Subexpression
+{
+    const Node *tree; // First occurrence, NULL if entry is empty
+    size_t count;
+    bool stored;      // True when result of first occurrence is already stored
+    size_t let_slot;
+};
+
+struct Compiler
+{
+    size_t num_vars;
+    const char **vars;
+    struct Subexpression *subexprs; // Open addressing with linear probing
+    size_t capacity;                // Power of two
+    size_t num_lets;
+    BatchProgram *program;
+};
+
+static bool is_derivative(const Node *tree)
+{
+    return get_op(tree)->id == ARITH_OP_DERIV || get_op(tree)->id == ARITH_OP_DERIV_POST;
+}
+
+static size_t count_operators(const Node *tree)
+{
+    if (get_type(tree) != NTYPE_OPERATOR) return 0;
+    size_t res = 1;
+    for (size_t i = 0; i < get_num_children(tree); i++) res += count_operators(get_child(tree, i));
+    return res;
+}
+
+static struct Subexpression *lookup_subexpr(const struct Compiler *compiler, const Node *tree)
+{
+    size_t index = get_hash(tree) & (compiler->capacity - 1);
+    while (compiler->subexprs[index].tree != NULL && !tree_equals(compiler->subexprs[index].tree, tree))
+    {
+        index = (index + 1) & (compiler->capacity - 1);
+    }
+    return compiler->subexprs + index;
+}
+
+/*
+Summary: Counts occurrences of operator subtrees that can be shared. Subtrees that contain impure operators
+    (e.g. rand) are excluded, since each occurrence has its own value. Operands of a repeated subtree are not
+    visited again, since they are only evaluated for its first occurrence. Derivatives are not compiled into
+    instructions, thus their operands are not visited either.
+Returns: True if tree is pure
+*/
+static bool count_subexprs(const struct Compiler *compiler, const Node *tree)
+{
+    if (get_type(tree) != NTYPE_OPERATOR) return true;
+    if (is_derivative(tree)) return false;
+
+    // Operators without operands are as cheap as a load
+    struct Subexpression *entry = get_num_children(tree) > 0 ? lookup_subexpr(compiler, tree) : NULL;
+    if (entry != NULL && entry->tree != NULL)
+    {
+        entry->count++;
+        return true;
+    }
+
+    bool pure = get_op(tree)->pure;
+    for (size_t i = 0; i < get_num_children(tree); i++)
+    {
+        if (!count_subexprs(compiler, get_child(tree, i))) pure = false;
+    }
+    if (pure && entry != NULL)
+    {
+        // Lookup is repeated since entries of operands may have been inserted meanwhile
+        entry = lookup_subexpr(compiler, tree);
+        entry->tree = tree;
+        entry->count = 1;
+    }
+    return pure;
+}
+
+static bool compile_rec(struct Compiler *compiler, const Node *tree, size_t slot)
+{
+    BatchProgram *program = compiler->program;
+    switch (get_type(tree))
+    {
+        case NTYPE_CONSTANT:
+            VEC_PUSH_ELEM(&program->instructions, BatchInstruction, ((BatchInstruction){
+                .type  = BATCH_CONSTANT,
+                .value = get_const_value(tree),
+                .slot  = slot
+            }));
+            return true;
+
+        case NTYPE_VARIABLE:
+            for (size_t i = 0; i < compiler->num_vars; i++)
+            {
+                if (strcmp(get_var_name(tree), compiler->vars[i]) == 0)
+                {
+                    VEC_PUSH_ELEM(&program->instructions, BatchInstruction, ((BatchInstruction){
+                        .type      = BATCH_VARIABLE,
+                        .var_index = i,
+                        .slot      = slot
+                    }));
+                    return true;
+                }
+            }
+            return false;
+
+        case NTYPE_OPERATOR:
+        {
+            // Derivatives are computed numerically instead of being rewritten symbolically
+            if (is_derivative(tree))
+            {
+                // Variable to differentiate by does not need to be bound
+                if (!is_bound(get_child(tree, 0), compiler->num_vars, compiler->vars)) return false;
+                VEC_PUSH_ELEM(&program->instructions, BatchInstruction, ((BatchInstruction){
+                    .type = BATCH_DERIVATIVE,
+                    .node = tree,
+                    .slot = slot
+                }));
+                return true;
+            }
+
+            // Repeated subexpression is loaded from its let-slot, which is written at its first occurrence
+            struct Subexpression *entry = lookup_subexpr(compiler, tree);
+            bool shared = entry->tree != NULL && entry->count > 1;
+            if (shared && entry->stored)
+            {
+                VEC_PUSH_ELEM(&program->instructions, BatchInstruction, ((BatchInstruction){
+                    .type     = BATCH_LOAD,
+                    .let_slot = entry->let_slot,
+                    .slot     = slot
+                }));
+                return true;
+            }
+
+            // Operands are placed next to each other, like on operand stack of tree_reduce
+            for (size_t i = 0; i < get_num_children(tree); i++)
+            {
+                if (!compile_rec(compiler, get_child(tree, i), slot + i)) return false;
+            }
+            VEC_PUSH_ELEM(&program->instructions, BatchInstruction, ((BatchInstruction){
+                .type     = BATCH_OPERATOR,
+                .op       = get_op(tree),
+                .num_args = get_num_children(tree),
+                .slot     = slot
+            }));
+            if (get_num_children(tree) > program->max_args) program->max_args = get_num_children(tree);
+
+            if (shared)
+            {
+                entry->stored = true;
+                entry->let_slot = compiler->num_lets++;
+                VEC_PUSH_ELEM(&program->instructions, BatchInstruction, ((BatchInstruction){
+                    .type     = BATCH_STORE,
+                    .let_slot = entry->let_slot,
+                    .slot     = slot
+                }));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+Summary: Compiles tree to a program that evaluates it for many bindings at once.
+    Subexpressions that occur more than once are evaluated once per row and kept in let-slots.
+Params
+    vars: Variable with index i is bound to column i when program is evaluated
+Returns: False if tree contains a variable that is not in vars
+    Program refers to tree and vars, which must not be freed before it
+*/
+bool batch_compile(const Node *tree, size_t num_vars, const char **vars, BatchProgram *out_program)
+{
+    *out_program = (BatchProgram){
+        .instructions = vec_create(sizeof(BatchInstruction), 1),
+        .num_slots    = tree_reduce_stack_size(tree),
+        .max_args     = 0,
+        .num_vars     = num_vars,
+        .vars         = vars
+    };
+
+    struct Compiler compiler = {
+        .num_vars = num_vars,
+        .vars     = vars,
+        .capacity = 1,
+        .num_lets = 0,
+        .program  = out_program
+    };
+    while (compiler.capacity < 2 * count_operators(tree) + 1) compiler.capacity *= 2;
+    compiler.subexprs = calloc_wrapper(compiler.capacity, sizeof(struct Subexpression));
+    count_subexprs(&compiler, tree);
+
+    bool success = compile_rec(&compiler, tree, 0);
+    free(compiler.subexprs);
+    if (!success)
+    {
+        batch_free(out_program);
+        return false;
+    }
+
+    // Let-slots follow slots of operand stack
+    for (size_t i = 0; i < vec_count(&out_program->instructions); i++)
+    {
+        BatchInstruction *instr = (BatchInstruction*)vec_get(&out_program->instructions, i);
+        if (instr->type == BATCH_LOAD || instr->type == BATCH_STORE) instr->let_slot += out_program->num_slots;
+    }
+    out_program->num_slots += compiler.num_lets;
+    return true;
+}
+
+void batch_free(BatchProgram *program)
+{
+    vec_destroy(&program->instructions);
+}
+
+// The first error of a row is kept, like tree_reduce returns the first error in evaluation order
+static void set_error(ListenerError *errors, size_t row, ListenerError err)
+{
+    if (errors[row] == LISTENERERR_SUCCESS) errors[row] = err;
+}
+
+/*
+Summary: Error lane of a row. Errors are recorded alongside values instead of aborting the row,
+    so that kernels stay loops without early exits. Like set_error, the first error of a row is kept.
+*/
+static inline ListenerError lane_error(ListenerError current, bool fails, ListenerError err)
+{
+    return (current == LISTENERERR_SUCCESS && fails) ? err : current;
+}
+
+// Functions of unary operators that can not fail, applied element-wise
+static double (*const UNARY_FUNCTIONS[NUM_ARITH_OPS])(double) = {
+    [ARITH_OP_EXP]   = exp,
+    [ARITH_OP_LN]    = log,
+    [ARITH_OP_LD]    = log2,
+    [ARITH_OP_LG]    = log10,
+    [ARITH_OP_SIN]   = sin,
+    [ARITH_OP_COS]   = cos,
+    [ARITH_OP_TAN]   = tan,
+    [ARITH_OP_ASIN]  = asin,
+    [ARITH_OP_ACOS]  = acos,
+    [ARITH_OP_ATAN]  = atan,
+    [ARITH_OP_SINH]  = sinh,
+    [ARITH_OP_COSH]  = cosh,
+    [ARITH_OP_TANH]  = tanh,
+    [ARITH_OP_ASINH] = asinh,
+    [ARITH_OP_ACOSH] = acosh,
+    [ARITH_OP_ATANH] = atanh,
+    [ARITH_OP_ROUND] = round
+};
+
+/*
+Summary: Applies operator of instruction to n rows. Kernels mirror arith_op_evaluate, they are written as simple
+    loops over columns that are independent of each other, so that they can be vectorized.
+Returns: False if there is no kernel for the operator
+*/
+static bool apply_kernel(const BatchInstruction *instr, size_t n, double *slots, ListenerError *errors)
+{
+    double *restrict x = slots + instr->slot * BATCH_BLOCK_SIZE;
+    const double *restrict y = slots + (instr->slot + 1) * BATCH_BLOCK_SIZE;
+
+    if (instr->op->id < NUM_ARITH_OPS && UNARY_FUNCTIONS[instr->op->id] != NULL)
+    {
+        double (*f)(double) = UNARY_FUNCTIONS[instr->op->id];
+        for (size_t i = 0; i < n; i++) x[i] = f(x[i]);
+        return true;
+    }
+
+    switch (instr->op->id)
+    {
+        case ARITH_OP_ADD: // x+y
+            for (size_t i = 0; i < n; i++) x[i] = x[i] + y[i];
+            return true;
+        case ARITH_OP_SUB: // x-y
+            for (size_t i = 0; i < n; i++) x[i] = x[i] - y[i];
+            return true;
+        case ARITH_OP_MUL: // x*y
+            for (size_t i = 0; i < n; i++) x[i] = x[i] * y[i];
+            return true;
+        case ARITH_OP_DIV: // x/y
+            for (size_t i = 0; i < n; i++)
+            {
+                errors[i] = lane_error(errors[i], y[i] == 0, LISTENERERR_DIVISION_BY_ZERO);
+                x[i] = x[i] / y[i];
+            }
+            return true;
+        case ARITH_OP_POW: // x^y
+            for (size_t i = 0; i < n; i++)
+            {
+                errors[i] = lane_error(errors[i], x[i] == 0 && y[i] <= 0, LISTENERERR_DIVISION_BY_ZERO);
+                errors[i] = lane_error(errors[i], x[i] < 0 && y[i] < 1, LISTENERERR_COMPLEX_SOLUTION);
+                x[i] = pow(x[i], y[i]);
+            }
+            return true;
+        case ARITH_OP_ROOT: // root(x, y)
+            for (size_t i = 0; i < n; i++)
+            {
+                errors[i] = lane_error(errors[i], !(x[i] >= 0), LISTENERERR_COMPLEX_SOLUTION);
+                x[i] = pow(x[i], 1 / y[i]);
+            }
+            return true;
+        case ARITH_OP_LOG: // log(x, y)
+            for (size_t i = 0; i < n; i++) x[i] = log(x[i]) / log(y[i]);
+            return true;
+        case ARITH_OP_PLUS: // +x
+            return true;
+        case ARITH_OP_NEG: // -x
+            for (size_t i = 0; i < n; i++) x[i] = -x[i];
+            return true;
+        case ARITH_OP_PERCENT: // x%
+            for (size_t i = 0; i < n; i++) x[i] = x[i] / 100;
+            return true;
+        case ARITH_OP_SQRT: // sqrt(x)
+            for (size_t i = 0; i < n; i++)
+            {
+                errors[i] = lane_error(errors[i], !(x[i] >= 0), LISTENERERR_COMPLEX_SOLUTION);
+                x[i] = sqrt(x[i]);
+            }
+            return true;
+        case ARITH_OP_ABS: // abs(x)
+            for (size_t i = 0; i < n; i++) x[i] = fabs(x[i]);
+            return true;
+        case ARITH_OP_CEIL: // ceil(x)
+            for (size_t i = 0; i < n; i++) x[i] = ceil(x[i]);
+            return true;
+        case ARITH_OP_FLOOR: // floor(x)
+            for (size_t i = 0; i < n; i++) x[i] = floor(x[i]);
+            return true;
+        case ARITH_OP_TRUNC: // trunc(x)
+            for (size_t i = 0; i < n; i++) x[i] = trunc(x[i]);
+            return true;
+        case ARITH_OP_FRAC: // frac(x)
+            for (size_t i = 0; i < n; i++) x[i] = x[i] - floor(x[i]);
+            return true;
+        case ARITH_OP_SGN: // sgn(x)
+            for (size_t i = 0; i < n; i++) x[i] = x[i] < 0 ? -1 : (x[i] > 0) ? 1 : 0;
+            return true;
+        case ARITH_OP_MAX: // max(x, y, ...)
+        case ARITH_OP_MIN: // min(x, y, ...)
+        case ARITH_OP_SUM: // sum(x, y, ...)
+        case ARITH_OP_PROD: // prod(x, y, ...)
+        case ARITH_OP_AVG: // avg(x, y, ...)
+        case ARITH_OP_VAR: // var(x, y, ...)
+        {
+            // Operands of a row are strided by block size, aggregate kernels give the same results as for a list
+            double (*aggregate)(const double*, size_t, size_t) = NULL;
+            switch (instr->op->id)
+            {
+                case ARITH_OP_MAX:  aggregate = aggregate_max; break;
+                case ARITH_OP_MIN:  aggregate = aggregate_min; break;
+                case ARITH_OP_SUM:  aggregate = aggregate_sum; break;
+                case ARITH_OP_PROD: aggregate = aggregate_prod; break;
+                case ARITH_OP_AVG:  aggregate = aggregate_avg; break;
+                default: aggregate = aggregate_variance;
+            }
+            for (size_t i = 0; i < n; i++) x[i] = aggregate(x + i, instr->num_args, BATCH_BLOCK_SIZE);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Applies operator row by row, rows that already failed are skipped since their operands are meaningless
+static void apply_scalar(const BatchInstruction *instr, size_t n, double *slots, ListenerError *errors, double *args)
+{
+    double *x = slots + instr->slot * BATCH_BLOCK_SIZE;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (errors[i] != LISTENERERR_SUCCESS)
+        {
+            x[i] = NAN;
+            continue;
+        }
+
+        for (size_t j = 0; j < instr->num_args; j++)
+        {
+            args[j] = slots[(instr->slot + j) * BATCH_BLOCK_SIZE + i];
+        }
+        double res;
+        ListenerError err = arith_op_evaluate(instr->op, instr->num_args, args, &res);
+        if (err != LISTENERERR_SUCCESS)
+        {
+            set_error(errors, i, err);
+            res = NAN;
+        }
+        x[i] = res;
+    }
+}
+
+// Evaluates derivative of instruction row by row, variables of row are bound to their column
+static void apply_derivative(const BatchProgram *program,
+    const BatchInstruction *instr,
+    size_t start,
+    size_t n,
+    const double **columns,
+    double *slots,
+    ListenerError *errors,
+    double *bindings)
+{
+    double *x = slots + instr->slot * BATCH_BLOCK_SIZE;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (errors[i] != LISTENERERR_SUCCESS)
+        {
+            x[i] = NAN;
+            continue;
+        }
+
+        for (size_t j = 0; j < program->num_vars; j++) bindings[j] = columns[j][start + i];
+        Dual res;
+        ListenerError err = dual_evaluate(instr->node, program->num_vars, program->vars, bindings, NULL, &res, NULL);
+        if (err != LISTENERERR_SUCCESS)
+        {
+            set_error(errors, i, err);
+            res.value = NAN;
+        }
+        x[i] = res.value;
+    }
+}
+
+/*
+Summary: Evaluates program for each row. Instructions are executed one after another for a whole block of rows.
+Params
+    columns:    Values of variable with index i are in columns[i], each column consists of num_rows values
+    out_values: Result of each row, NaN if evaluation of row failed
+    out_errors: Error of each row, LISTENERERR_SUCCESS if there is none. Is allowed to be NULL
+*/
+void batch_evaluate(const BatchProgram *program,
+    size_t num_rows,
+    const double **columns,
+    double *out_values,
+    ListenerError *out_errors)
+{
+    double *slots = malloc_wrapper(program->num_slots * BATCH_BLOCK_SIZE * sizeof(double));
+    double *args = malloc_wrapper((program->max_args + 1) * sizeof(double));
+    double *bindings = malloc_wrapper((program->num_vars + 1) * sizeof(double));
+    ListenerError errors[BATCH_BLOCK_SIZE];
+
+    for (size_t start = 0; start < num_rows; start += BATCH_BLOCK_SIZE)
+    {
+        size_t n = num_rows - start < BATCH_BLOCK_SIZE ? num_rows - start : BATCH_BLOCK_SIZE;
+        for (size_t i = 0; i < n; i++) errors[i] = LISTENERERR_SUCCESS;
+
+        for (size_t k = 0; k < vec_count(&program->instructions); k++)
+        {
+            const BatchInstruction *instr = (const BatchInstruction*)vec_get(&program->instructions, k);
+            double *dest = slots + instr->slot * BATCH_BLOCK_SIZE;
+            switch (instr->type)
+            {
+                case BATCH_CONSTANT:
+                    for (size_t i = 0; i < n; i++) dest[i] = instr->value;
+                    break;
+
+                case BATCH_VARIABLE:
+                    memcpy(dest, columns[instr->var_index] + start, n * sizeof(double));
+                    break;
+
+                case BATCH_OPERATOR:
+                    if (!apply_kernel(instr, n, slots, errors))
+                    {
+                        apply_scalar(instr, n, slots, errors, args);
+                    }
+                    break;
+
+                case BATCH_DERIVATIVE:
+                    apply_derivative(program, instr, start, n, columns, slots, errors, bindings);
+                    break;
+
+                case BATCH_LOAD:
+                    memcpy(dest, slots + instr->let_slot * BATCH_BLOCK_SIZE, n * sizeof(double));
+                    break;
+
+                case BATCH_STORE:
+                    memcpy(slots + instr->let_slot * BATCH_BLOCK_SIZE, dest, n * sizeof(double));
+                    break;
+            }
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            out_values[start + i] = errors[i] == LISTENERERR_SUCCESS ? slots[i] : NAN;
+            if (out_errors != NULL) out_errors[start + i] = errors[i];
+        }
+    }
+
+    free(slots);
+    free(args);
+    free(bindings);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdbool.h>
+#include "../../util/vector.h"
+#include "../../engine/tree/node.h"
+#include "../../engine/tree/tree_util.h"
+
+/*
+Batch evaluation: An expression is compiled once and then evaluated for many bindings of its variables.
+Values of a variable are given as column, operators are applied to blocks of rows at once.
+*/
+
+typedef enum
+{
+    BATCH_CONSTANT,
+    BATCH_VARIABLE,
+    BATCH_OPERATOR,
+    BATCH_DERIVATIVE,
+    BATCH_LOAD,  // Copies let-slot to slot
+    BATCH_STORE  // Copies slot to let-slot
+} BatchInstructionType;
+
+typedef struct
+{
+    BatchInstructionType type;
+    double value;       // Of BATCH_CONSTANT
+    size_t var_index;   // Of BATCH_VARIABLE, index of column
+    const Operator *op; // Of BATCH_OPERATOR
+    size_t num_args;    // Of BATCH_OPERATOR, operands are in slots slot to slot + num_args - 1
+    const Node *node;   // Of BATCH_DERIVATIVE, is evaluated row by row by dual_evaluate
+    size_t let_slot;    // Of BATCH_LOAD and BATCH_STORE, holds value of a repeated subexpression
+    size_t slot;        // Result is placed in this slot
+} BatchInstruction;
+
+typedef struct
+{
+    Vector instructions; // BatchInstruction in postfix order
+    size_t num_slots;    // Number of columns of intermediate values needed at most
+    size_t max_args;     // Largest number of operands of an operator
+    size_t num_vars;
+    const char **vars;   // Bindings of derivatives, must outlive program
+} BatchProgram;
+
+bool batch_compile(const Node *tree, size_t num_vars, const char **vars, BatchProgram *out_program);
+void batch_evaluate(const BatchProgram *program,
+    size_t num_rows,
+    const double **columns,
+    double *out_values,
+    ListenerError *out_errors);
+void batch_free(BatchProgram *program);
@@ -0,0 +1,337 @@
+#include <string.h>
+#include <math.h>
+
+#include "../../util/alloc_wrappers.h"
+#include "compensated_evaluation.h"
+#include "arith_evaluation.h"
+
+#define INLINE_ARGS 8 // Operands of operators with fewer children are held on call stack
+
+static bool compensated = false; // Process-wide, shared by all sessions
+
+void set_compensated_evaluation(bool value)
+{
+    compensated = value;
+}
+
+bool get_compensated_evaluation()
+{
+    return compensated;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ ARITHMETIC
+
+// Error-free transformation: s + e == a + b exactly
+static DoubleDouble two_sum(double a, double b)
+{
+    double s = a + b;
+    double bb = s - a;
+    return (DoubleDouble){ s, (a - (s - bb)) + (b - bb) };
+}
+
+// Like two_sum, but requires |a| >= |b|
+static DoubleDouble quick_two_sum(double a, double b)
+{
+    double s = a + b;
+    return (DoubleDouble){ s, b - (s - a) };
+}
+
+// Error-free transformation: p + e == a * b exactly (barring underflow)
+static DoubleDouble two_prod(double a, double b)
+{
+    double p = a * b;
+    return (DoubleDouble){ p, fma(a, b, -p) };
+}
+
+// Infinities and NaNs have no meaningful error term, which would become NaN otherwise
+static DoubleDouble normalize(DoubleDouble x)
+{
+    if (!isfinite(x.hi)) return (DoubleDouble){ x.hi, 0 };
+    return quick_two_sum(x.hi, x.lo);
+}
+
+DoubleDouble dd_from_double(double x)
+{
+    return (DoubleDouble){ x, 0 };
+}
+
+double dd_to_double(DoubleDouble x)
+{
+    return x.hi + x.lo;
+}
+
+static DoubleDouble dd_neg(DoubleDouble a)
+{
+    return (DoubleDouble){ -a.hi, -a.lo };
+}
+
+DoubleDouble dd_add(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble s = two_sum(a.hi, b.hi);
+    DoubleDouble t = two_sum(a.lo, b.lo);
+    if (!isfinite(s.hi)) return (DoubleDouble){ s.hi, 0 };
+    s.lo += t.hi;
+    s = quick_two_sum(s.hi, s.lo);
+    s.lo += t.lo;
+    return normalize(s);
+}
+
+DoubleDouble dd_mul(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble p = two_prod(a.hi, b.hi);
+    if (!isfinite(p.hi)) return (DoubleDouble){ p.hi, 0 };
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return normalize(p);
+}
+
+// Long division with two correction steps, b must not be zero
+DoubleDouble dd_div(DoubleDouble a, DoubleDouble b)
+{
+    double q1 = a.hi / b.hi;
+    if (!isfinite(q1)) return (DoubleDouble){ q1, 0 };
+    DoubleDouble r = dd_add(a, dd_neg(dd_mul(b, dd_from_double(q1))));
+    double q2 = r.hi / b.hi;
+    r = dd_add(r, dd_neg(dd_mul(b, dd_from_double(q2))));
+    double q3 = r.hi / b.hi;
+    return dd_add(quick_two_sum(q1, q2), dd_from_double(q3));
+}
+
+static bool dd_less(DoubleDouble a, DoubleDouble b)
+{
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+static DoubleDouble dd_sum(size_t n, const DoubleDouble *x)
+{
+    DoubleDouble res = dd_from_double(0);
+    for (size_t i = 0; i < n; i++) res = dd_add(res, x[i]);
+    return res;
+}
+
+// Population variance by two passes, cancellation is harmless since deviations are computed in double-double
+static DoubleDouble dd_variance(size_t n, const DoubleDouble *x)
+{
+    if (n == 0) return dd_from_double(NAN);
+    DoubleDouble mean = dd_div(dd_sum(n, x), dd_from_double(n));
+    DoubleDouble m2 = dd_from_double(0);
+    for (size_t i = 0; i < n; i++)
+    {
+        DoubleDouble delta = dd_add(x[i], dd_neg(mean));
+        m2 = dd_add(m2, dd_mul(delta, delta));
+    }
+    return dd_div(m2, dd_from_double(n));
+}
+
+/*
+Summary: Applies operator to operands in double-double. Operators without compensated form are evaluated
+    by arith_op_evaluate, their operands are rounded to double.
+*/
+static ListenerError dd_apply(const Operator *op, size_t num_args, const DoubleDouble *args, DoubleDouble *out)
+{
+    switch (op->id)
+    {
+        case ARITH_OP_ADD:
+            *out = dd_add(args[0], args[1]);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_SUB:
+            *out = dd_add(args[0], dd_neg(args[1]));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_MUL:
+            *out = dd_mul(args[0], args[1]);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_DIV:
+            if (args[1].hi == 0) return LISTENERERR_DIVISION_BY_ZERO;
+            *out = dd_div(args[0], args[1]);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_PLUS:
+            *out = args[0];
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_NEG:
+            *out = dd_neg(args[0]);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_PERCENT:
+            *out = dd_div(args[0], dd_from_double(100));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_SUM:
+            *out = dd_sum(num_args, args);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_PROD:
+            *out = dd_from_double(1);
+            for (size_t i = 0; i < num_args; i++) *out = dd_mul(*out, args[i]);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_AVG:
+            *out = num_args == 0 ? dd_from_double(0) : dd_div(dd_sum(num_args, args), dd_from_double(num_args));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_VAR:
+            *out = dd_variance(num_args, args);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_MAX:
+        case ARITH_OP_MIN:
+            // Like comparisons in a loop that starts with -INFINITY or INFINITY, NaNs are ignored
+            *out = dd_from_double(op->id == ARITH_OP_MAX ? -INFINITY : INFINITY);
+            for (size_t i = 0; i < num_args; i++)
+            {
+                if (op->id == ARITH_OP_MAX ? dd_less(*out, args[i]) : dd_less(args[i], *out)) *out = args[i];
+            }
+            return LISTENERERR_SUCCESS;
+    }
+
+    double inline_args[INLINE_ARGS];
+    double *rounded = num_args <= INLINE_ARGS ? inline_args : malloc_wrapper(num_args * sizeof(double));
+    for (size_t i = 0; i < num_args; i++)
+    {
+        rounded[i] = dd_to_double(args[i]);
+    }
+    double res;
+    ListenerError err = arith_op_evaluate(op, num_args, rounded, &res);
+    if (rounded != inline_args) free(rounded);
+    if (err == LISTENERERR_SUCCESS) *out = dd_from_double(res);
+    return err;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ TREES
+
+/*
+Summary: Evaluates tree in double-double, post-order like tree_reduce
+Params
+    vars, values: Variable vars[i] is bound to values[i]
+Returns: LISTENERERR_VARIABLE_ENCOUNTERED if tree contains a variable that is not bound
+*/
+ListenerError dd_evaluate(const Node *tree,
+    size_t num_vars,
+    const char **vars,
+    const DoubleDouble *values,
+    DoubleDouble *out,
+    const Node **out_errnode)
+{
+    switch (get_type(tree))
+    {
+        case NTYPE_CONSTANT:
+            *out = dd_from_double(get_const_value(tree));
+            return LISTENERERR_SUCCESS;
+
+        case NTYPE_VARIABLE:
+            for (size_t i = 0; i < num_vars; i++)
+            {
+                if (strcmp(get_var_name(tree), vars[i]) == 0)
+                {
+                    *out = values[i];
+                    return LISTENERERR_SUCCESS;
+                }
+            }
+            if (out_errnode != NULL) *out_errnode = tree;
+            return LISTENERERR_VARIABLE_ENCOUNTERED;
+
+        case NTYPE_OPERATOR:
+        {
+            size_t num_children = get_num_children(tree);
+            DoubleDouble inline_args[INLINE_ARGS];
+            DoubleDouble *args = num_children <= INLINE_ARGS
+                ? inline_args
+                : malloc_wrapper(num_children * sizeof(DoubleDouble));
+
+            ListenerError err = LISTENERERR_SUCCESS;
+            for (size_t i = 0; i < num_children && err == LISTENERERR_SUCCESS; i++)
+            {
+                err = dd_evaluate(get_child(tree, i), num_vars, vars, values, args + i, out_errnode);
+            }
+            if (err == LISTENERERR_SUCCESS)
+            {
+                err = dd_apply(get_op(tree), num_children, args, out);
+                if (err != LISTENERERR_SUCCESS && out_errnode != NULL) *out_errnode = tree;
+            }
+
+            if (args != inline_args) free(args);
+            return err;
+        }
+    }
+    return LISTENERERR_SUCCESS;
+}
+
+struct Operand
+{
+    DoubleDouble value;
+    bool is_constant;
+};
+
+/*
+Summary: Computes value of tree if it is constant. Otherwise, constant children are replaced by a ConstantNode.
+    Values are only rounded to double when a maximal constant subtree is replaced.
+    Random numbers are treated like variables when fold_random is false.
+*/
+static ListenerError reduce_rec(Node **tree, bool fold_random, struct Operand *out, const Node **out_errnode)
+{
+    switch (get_type(*tree))
+    {
+        case NTYPE_CONSTANT:
+            *out = (struct Operand){ dd_from_double(get_const_value(*tree)), true };
+            return LISTENERERR_SUCCESS;
+
+        case NTYPE_VARIABLE:
+            *out = (struct Operand){ dd_from_double(0), false };
+            return LISTENERERR_SUCCESS;
+
+        case NTYPE_OPERATOR:
+        {
+            size_t num_children = get_num_children(*tree);
+            struct Operand inline_operands[INLINE_ARGS];
+            DoubleDouble inline_args[INLINE_ARGS];
+            struct Operand *operands = num_children <= INLINE_ARGS
+                ? inline_operands
+                : malloc_wrapper(num_children * sizeof(struct Operand));
+            DoubleDouble *args = num_children <= INLINE_ARGS
+                ? inline_args
+                : malloc_wrapper(num_children * sizeof(DoubleDouble));
+
+            ListenerError err = LISTENERERR_SUCCESS;
+            out->is_constant = fold_random || get_op(*tree)->id != ARITH_OP_RAND;
+            for (size_t i = 0; i < num_children && err == LISTENERERR_SUCCESS; i++)
+            {
+                err = reduce_rec(get_child_addr(*tree, i), fold_random, operands + i, out_errnode);
+                args[i] = operands[i].value;
+                if (!operands[i].is_constant) out->is_constant = false;
+            }
+
+            if (err == LISTENERERR_SUCCESS)
+            {
+                if (out->is_constant)
+                {
+                    err = dd_apply(get_op(*tree), num_children, args, &out->value);
+                    if (err != LISTENERERR_SUCCESS && out_errnode != NULL) *out_errnode = *tree;
+                }
+                else
+                {
+                    for (size_t i = 0; i < num_children; i++)
+                    {
+                        Node **child = get_child_addr(*tree, i);
+                        if (operands[i].is_constant && get_type(*child) == NTYPE_OPERATOR)
+                        {
+                            tree_replace(child,
+                                malloc_constant_node(dd_to_double(operands[i].value), get_token_index(*child)));
+                        }
+                    }
+                }
+            }
+
+            if (operands != inline_operands) free(operands);
+            if (args != inline_args) free(args);
+            return err;
+        }
+    }
+    return LISTENERERR_SUCCESS;
+}
+
+/*
+Summary: Like tree_reduce_constant_subtrees, but subtrees are evaluated in double-double
+*/
+ListenerError dd_reduce_constant_subtrees(Node **tree, bool fold_random, const Node **out_errnode)
+{
+    struct Operand res;
+    ListenerError err = reduce_rec(tree, fold_random, &res, out_errnode);
+    if (err != LISTENERERR_SUCCESS) return err;
+    if (res.is_constant && get_type(*tree) == NTYPE_OPERATOR)
+    {
+        tree_replace(tree, malloc_constant_node(dd_to_double(res.value), get_token_index(*tree)));
+    }
+    return LISTENERERR_SUCCESS;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdbool.h>
+#include "../../engine/tree/node.h"
+#include "../../engine/tree/tree_util.h"
+
+/*
+Compensated evaluation: Values are represented as unevaluated sum hi + lo of two doubles (double-double),
+which roughly doubles the number of significant digits. +, -, *, / and aggregates are computed error-free,
+other operators are evaluated in double precision.
+Whether constant subtrees and tables are evaluated compensated is a process-wide switch. It is not part of a Session,
+so changing it affects evaluations of all threads.
+*/
+
+typedef struct
+{
+    double hi; // Value rounded to double
+    double lo; // Rounding error of hi, |lo| <= ulp(hi) / 2
+} DoubleDouble;
+
+void set_compensated_evaluation(bool value);
+bool get_compensated_evaluation();
+
+DoubleDouble dd_from_double(double x);
+double dd_to_double(DoubleDouble x);
+DoubleDouble dd_add(DoubleDouble a, DoubleDouble b);
+DoubleDouble dd_mul(DoubleDouble a, DoubleDouble b);
+DoubleDouble dd_div(DoubleDouble a, DoubleDouble b);
+
+ListenerError dd_evaluate(const Node *tree,
+    size_t num_vars,
+    const char **vars,
+    const DoubleDouble *values,
+    DoubleDouble *out,
+    const Node **out_errnode);
+ListenerError dd_reduce_constant_subtrees(Node **tree, bool fold_random, const Node **out_errnode);
@@ -0,0 +1,273 @@
+#include <string.h>
+#include <math.h>
+
+#include "../../util/alloc_wrappers.h"
+#include "dual_evaluation.h"
+#include "arith_evaluation.h"
+
+#define INLINE_ARGS 8 // Operands of operators with fewer children are held on call stack
+
+struct Bindings
+{
+    size_t num_vars;
+    const char **vars;
+    const double *values;
+};
+
+static ListenerError dual_rec(const Node *tree,
+    const struct Bindings *bindings,
+    const char *seed,
+    Dual *out,
+    const Node **out_errnode);
+
+/*
+Summary: Computes derivative of first operand with respect to variable of second one, or to the only variable of
+    the operand of shorthand f'. Derivatives of derivatives are not supported, thus the result is only
+    differentiable if it does not depend on the outer seed.
+*/
+static ListenerError eval_derivative(const Node *tree,
+    const struct Bindings *bindings,
+    const char *seed,
+    Dual *out,
+    const Node **out_errnode)
+{
+    const Node *expr = get_child(tree, 0);
+    const char *var = NULL;
+    if (get_num_children(tree) == 2)
+    {
+        if (get_type(get_child(tree, 1)) != NTYPE_VARIABLE)
+        {
+            if (out_errnode != NULL) *out_errnode = tree;
+            return LISTENERERR_MALFORMED_DERIV_B;
+        }
+        var = get_var_name(get_child(tree, 1));
+    }
+    else
+    {
+        bool sufficient = false;
+        list_variables((Node*)expr, 1, &var, &sufficient);
+        if (!sufficient)
+        {
+            if (out_errnode != NULL) *out_errnode = tree;
+            return LISTENERERR_MALFORMED_DERIV_A;
+        }
+    }
+
+    if (seed != NULL && get_variable_nodes(&expr, seed, 0, NULL) > 0)
+    {
+        if (out_errnode != NULL) *out_errnode = tree;
+        return LISTENERERR_IMPOSSIBLE_DERIV;
+    }
+
+    Dual inner = { 0, 0 };
+    ListenerError err = var == NULL
+        ? LISTENERERR_SUCCESS // Derivative of a constant expression is 0
+        : dual_rec(expr, bindings, var, &inner, out_errnode);
+    *out = (Dual){ inner.deriv, 0 };
+    return err;
+}
+
+/*
+Summary: Computes derivative of operator application. Value of the application is already computed.
+Returns: LISTENERERR_IMPOSSIBLE_DERIV if operator has no derivative and an operand depends on seed
+*/
+static ListenerError derive(const Operator *op, size_t num_args, const Dual *args, Dual *out)
+{
+    double a = num_args > 0 ? args[0].value : 0;
+    double da = num_args > 0 ? args[0].deriv : 0;
+    double b = num_args > 1 ? args[1].value : 0;
+    double db = num_args > 1 ? args[1].deriv : 0;
+    double r = out->value;
+
+    switch (op->id)
+    {
+        case ARITH_OP_ADD:     out->deriv = da + db; return LISTENERERR_SUCCESS;
+        case ARITH_OP_SUB:     out->deriv = da - db; return LISTENERERR_SUCCESS;
+        case ARITH_OP_MUL:     out->deriv = da * b + a * db; return LISTENERERR_SUCCESS;
+        case ARITH_OP_DIV:     out->deriv = (da - r * db) / b; return LISTENERERR_SUCCESS;
+        case ARITH_OP_PLUS:    out->deriv = da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_NEG:     out->deriv = -da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_PERCENT: out->deriv = da / 100; return LISTENERERR_SUCCESS;
+        case ARITH_OP_EXP:     out->deriv = r * da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_SQRT:    out->deriv = da / (2 * r); return LISTENERERR_SUCCESS;
+        case ARITH_OP_LN:      out->deriv = da / a; return LISTENERERR_SUCCESS;
+        case ARITH_OP_LD:      out->deriv = da / (a * log(2)); return LISTENERERR_SUCCESS;
+        case ARITH_OP_LG:      out->deriv = da / (a * log(10)); return LISTENERERR_SUCCESS;
+        case ARITH_OP_LOG:     out->deriv = (da / a - r * db / b) / log(b); return LISTENERERR_SUCCESS;
+        case ARITH_OP_SIN:     out->deriv = cos(a) * da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_COS:     out->deriv = -sin(a) * da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_TAN:     out->deriv = da / (cos(a) * cos(a)); return LISTENERERR_SUCCESS;
+        case ARITH_OP_ASIN:    out->deriv = da / sqrt(1 - a * a); return LISTENERERR_SUCCESS;
+        case ARITH_OP_ACOS:    out->deriv = -da / sqrt(1 - a * a); return LISTENERERR_SUCCESS;
+        case ARITH_OP_ATAN:    out->deriv = da / (1 + a * a); return LISTENERERR_SUCCESS;
+        case ARITH_OP_SINH:    out->deriv = cosh(a) * da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_COSH:    out->deriv = sinh(a) * da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_TANH:    out->deriv = (1 - r * r) * da; return LISTENERERR_SUCCESS;
+        case ARITH_OP_ASINH:   out->deriv = da / sqrt(a * a + 1); return LISTENERERR_SUCCESS;
+        case ARITH_OP_ACOSH:   out->deriv = da / sqrt(a * a - 1); return LISTENERERR_SUCCESS;
+        case ARITH_OP_ATANH:   out->deriv = da / (1 - a * a); return LISTENERERR_SUCCESS;
+        case ARITH_OP_ABS:     out->deriv = a > 0 ? da : (a < 0 ? -da : 0); return LISTENERERR_SUCCESS;
+        case ARITH_OP_FRAC:    out->deriv = da; return LISTENERERR_SUCCESS;
+
+        // Piecewise constant, derivative is 0 except at jumps
+        case ARITH_OP_CEIL:
+        case ARITH_OP_FLOOR:
+        case ARITH_OP_ROUND:
+        case ARITH_OP_TRUNC:
+        case ARITH_OP_SGN:
+            out->deriv = 0;
+            return LISTENERERR_SUCCESS;
+
+        case ARITH_OP_POW:
+            // Exponent that does not depend on seed avoids log of base, which may be negative
+            out->deriv = db == 0
+                ? (da == 0 ? 0 : b * pow(a, b - 1) * da)
+                : r * (db * log(a) + (da == 0 ? 0 : b * da / a));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ROOT:
+            // root(a, b) = a^(1/b)
+            out->deriv = (da == 0 ? 0 : r * da / (b * a)) - (db == 0 ? 0 : r * log(a) * db / (b * b));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_MOD:
+            if (db != 0) break;
+            out->deriv = da;
+            return LISTENERERR_SUCCESS;
+
+        case ARITH_OP_MAX:
+        case ARITH_OP_MIN:
+            // Derivative of operand that is selected
+            out->deriv = 0;
+            for (size_t i = 0; i < num_args; i++)
+            {
+                if (args[i].value == r)
+                {
+                    out->deriv = args[i].deriv;
+                    break;
+                }
+            }
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_SUM:
+        case ARITH_OP_AVG:
+            out->deriv = 0;
+            for (size_t i = 0; i < num_args; i++) out->deriv += args[i].deriv;
+            if (op->id == ARITH_OP_AVG && num_args != 0) out->deriv /= num_args;
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_PROD:
+        {
+            // Product rule applied while multiplying, operands may be zero
+            double prod = 1;
+            out->deriv = 0;
+            for (size_t i = 0; i < num_args; i++)
+            {
+                out->deriv = out->deriv * args[i].value + prod * args[i].deriv;
+                prod *= args[i].value;
+            }
+            return LISTENERERR_SUCCESS;
+        }
+        case ARITH_OP_VAR:
+        {
+            double mean = 0;
+            double dmean = 0;
+            for (size_t i = 0; i < num_args; i++)
+            {
+                mean += args[i].value / num_args;
+                dmean += args[i].deriv / num_args;
+            }
+            out->deriv = 0;
+            for (size_t i = 0; i < num_args; i++)
+            {
+                out->deriv += 2 * (args[i].value - mean) * (args[i].deriv - dmean) / num_args;
+            }
+            return LISTENERERR_SUCCESS;
+        }
+    }
+
+    // Other operators are only differentiable if their operands do not depend on seed
+    for (size_t i = 0; i < num_args; i++)
+    {
+        if (args[i].deriv != 0) return LISTENERERR_IMPOSSIBLE_DERIV;
+    }
+    out->deriv = 0;
+    return LISTENERERR_SUCCESS;
+}
+
+static ListenerError dual_rec(const Node *tree,
+    const struct Bindings *bindings,
+    const char *seed,
+    Dual *out,
+    const Node **out_errnode)
+{
+    switch (get_type(tree))
+    {
+        case NTYPE_CONSTANT:
+            *out = (Dual){ get_const_value(tree), 0 };
+            return LISTENERERR_SUCCESS;
+
+        case NTYPE_VARIABLE:
+            for (size_t i = 0; i < bindings->num_vars; i++)
+            {
+                if (strcmp(get_var_name(tree), bindings->vars[i]) == 0)
+                {
+                    *out = (Dual){ bindings->values[i], seed != NULL && strcmp(get_var_name(tree), seed) == 0 };
+                    return LISTENERERR_SUCCESS;
+                }
+            }
+            if (out_errnode != NULL) *out_errnode = tree;
+            return LISTENERERR_VARIABLE_ENCOUNTERED;
+
+        case NTYPE_OPERATOR:
+        {
+            const Operator *op = get_op(tree);
+            if (op->id == ARITH_OP_DERIV || op->id == ARITH_OP_DERIV_POST)
+            {
+                return eval_derivative(tree, bindings, seed, out, out_errnode);
+            }
+
+            size_t num_children = get_num_children(tree);
+            Dual inline_args[INLINE_ARGS];
+            double inline_values[INLINE_ARGS];
+            Dual *args = num_children <= INLINE_ARGS ? inline_args : malloc_wrapper(num_children * sizeof(Dual));
+            double *values = num_children <= INLINE_ARGS
+                ? inline_values
+                : malloc_wrapper(num_children * sizeof(double));
+
+            ListenerError err = LISTENERERR_SUCCESS;
+            for (size_t i = 0; i < num_children && err == LISTENERERR_SUCCESS; i++)
+            {
+                err = dual_rec(get_child(tree, i), bindings, seed, args + i, out_errnode);
+                values[i] = args[i].value;
+            }
+            if (err == LISTENERERR_SUCCESS)
+            {
+                // Values are computed like by tree_reduce, so that both report the same errors
+                err = arith_op_evaluate(op, num_children, values, &out->value);
+                if (err == LISTENERERR_SUCCESS) err = derive(op, num_children, args, out);
+                if (err != LISTENERERR_SUCCESS && out_errnode != NULL) *out_errnode = tree;
+            }
+
+            if (args != inline_args) free(args);
+            if (values != inline_values) free(values);
+            return err;
+        }
+    }
+    return LISTENERERR_SUCCESS;
+}
+
+/*
+Summary: Evaluates tree and its derivative with respect to seed. Derivatives within tree are evaluated numerically.
+Params
+    vars, values: Variable vars[i] is bound to values[i]
+    seed:         Variable to differentiate by, NULL if only value is of interest
+Returns: LISTENERERR_VARIABLE_ENCOUNTERED if tree contains a variable that is not bound
+*/
+ListenerError dual_evaluate(const Node *tree,
+    size_t num_vars,
+    const char **vars,
+    const double *values,
+    const char *seed,
+    Dual *out,
+    const Node **out_errnode)
+{
+    struct Bindings bindings = { num_vars, vars, values };
+    return dual_rec(tree, &bindings, seed, out, out_errnode);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "../../engine/tree/node.h"
+#include "../../engine/tree/tree_util.h"
+
+/*
+Dual evaluation: Forward-mode automatic differentiation. Each value carries its derivative with respect to one
+variable, so that deriv(f, x) is computed numerically in a single pass over f instead of by rewriting it.
+*/
+
+typedef struct
+{
+    double value;
+    double deriv; // Derivative of value with respect to seeded variable
+} Dual;
+
+ListenerError dual_evaluate(const Node *tree,
+    size_t num_vars,
+    const char **vars,
+    const double *values,
+    const char *seed,
+    Dual *out,
+    const Node **out_errnode);
@@ -1,18 +1,18 @@
-#include "../../util/vector.h"
+#include "session.h"
 #include "history.h"
 
-#define HISTORY_STARTSIZE 8
-
-Vector ans_vec; // Results of last evaluations (doubles)
+// History of the session that is bound to calling thread, see session.h
 
 void init_history()
 {
-    ans_vec = vec_create(sizeof(double), HISTORY_STARTSIZE);
+    vec_clear(&session_default()->history);
 }
 
 void unload_history()
 {
-    vec_destroy(&ans_vec);
+    Session *session = session_default();
+    vec_destroy(&session->history);
+    session->history = (Vector){ sizeof(double), 0, 0, NULL };
 }
 
 /*
@@ -21,12 +21,10 @@ Params
 */
 bool history_get(size_t index, double *out)
 {
-    if (vec_count(&ans_vec) <= index) return false;
-    *out = *(double*)vec_get(&ans_vec, vec_count(&ans_vec) - 1 - index);
-    return true;
+    return session_history_get(session_current(), index, out);
 }
 
 void history_add(double value)
 {
-    VEC_PUSH_ELEM(&ans_vec, double, value);
+    session_history_add(session_current(), value);
 }
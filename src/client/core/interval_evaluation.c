@@ -0,0 +1,374 @@
+#include <string.h>
+#include <math.h>
+
+#include "../../util/alloc_wrappers.h"
+#include "interval_evaluation.h"
+#include "arith_evaluation.h"
+
+#define INLINE_ARGS 8 // Operands of operators with fewer children are held on call stack
+#define PI          3.14159265358979323846
+
+static const Interval ENTIRE = { -INFINITY, INFINITY };
+
+// Bounds of inexact operations are widened by one ulp, which also covers libm functions with an error below one ulp
+static Interval outward(double lo, double hi)
+{
+    if (isnan(lo) || isnan(hi)) return ENTIRE;
+    return (Interval){ nextafter(lo, -INFINITY), nextafter(hi, INFINITY) };
+}
+
+// For operations that are exact, such as negation or rounding to integers
+static Interval exact(double lo, double hi)
+{
+    if (isnan(lo) || isnan(hi)) return ENTIRE;
+    return (Interval){ lo, hi };
+}
+
+static bool is_point(Interval x)
+{
+    return x.lo == x.hi;
+}
+
+static bool contains(Interval x, double value)
+{
+    return x.lo <= value && value <= x.hi;
+}
+
+// Product as limit, so that 0 * inf is 0 instead of NaN
+static double mul_bound(double a, double b)
+{
+    return (a == 0 || b == 0) ? 0 : a * b;
+}
+
+static Interval corners(double a, double b, double c, double d)
+{
+    return outward(fmin(fmin(a, b), fmin(c, d)), fmax(fmax(a, b), fmax(c, d)));
+}
+
+static Interval interval_add(Interval a, Interval b)
+{
+    return outward(a.lo + b.lo, a.hi + b.hi);
+}
+
+static Interval interval_mul(Interval a, Interval b)
+{
+    return corners(mul_bound(a.lo, b.lo), mul_bound(a.lo, b.hi), mul_bound(a.hi, b.lo), mul_bound(a.hi, b.hi));
+}
+
+// Divisor must not contain zero
+static Interval interval_div(Interval a, Interval b)
+{
+    return corners(a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi);
+}
+
+static Interval increasing(double (*f)(double), Interval x)
+{
+    return outward(f(x.lo), f(x.hi));
+}
+
+/*
+Summary: Bounds of a periodic function with period 2pi that has its maximum at peak and minimum at peak + pi
+    Extrema that are only nearly contained are included, which can only make bounds wider
+*/
+static Interval periodic(double (*f)(double), double peak, Interval x)
+{
+    if (!(x.hi - x.lo < 2 * PI)) return (Interval){ -1, 1 };
+
+    const double slack = 1e-9 * (1 + fmax(fabs(x.lo), fabs(x.hi)));
+    double lo = fmin(f(x.lo), f(x.hi));
+    double hi = fmax(f(x.lo), f(x.hi));
+    double k = ceil((x.lo - slack - peak) / (2 * PI));
+    if (peak + 2 * PI * k <= x.hi + slack) hi = 1;
+    k = ceil((x.lo - slack - peak - PI) / (2 * PI));
+    if (peak + PI + 2 * PI * k <= x.hi + slack) lo = -1;
+
+    Interval res = outward(lo, hi);
+    return (Interval){ fmax(res.lo, -1), fmin(res.hi, 1) };
+}
+
+// Restricts x to domain of a function, points outside of it evaluate to NaN. False if intersection is empty.
+static bool clip(Interval *x, double lo, double hi)
+{
+    x->lo = fmax(x->lo, lo);
+    x->hi = fmin(x->hi, hi);
+    return x->lo <= x->hi;
+}
+
+// Each point of x >= 0 and y, pow(x, y) is monotonic in x and in y. Thus, extrema are at corners.
+static Interval interval_pow(Interval x, Interval y)
+{
+    if (x.lo >= 0) return corners(pow(x.lo, y.lo), pow(x.lo, y.hi), pow(x.hi, y.lo), pow(x.hi, y.hi));
+
+    // Negative bases only have real results for integer exponents
+    if (!is_point(y) || y.lo != trunc(y.lo)) return ENTIRE;
+    if (fmod(y.lo, 2) != 0) return outward(pow(x.lo, y.lo), pow(x.hi, y.lo));
+    if (x.hi <= 0) return outward(pow(x.hi, y.lo), pow(x.lo, y.lo));
+    return (Interval){ 0, outward(0, pow(fmax(-x.lo, x.hi), y.lo)).hi };
+}
+
+/*
+Summary: Applies operator to intervals of its operands
+Params
+    out_certain: Set to true if error occurs for every point, to false if it occurs for some of them
+Returns: Error that occurs for some point of operands, LISTENERERR_SUCCESS if there is none
+*/
+static ListenerError apply(const Operator *op, size_t num_args, const Interval *args, Interval *out, bool *out_certain)
+{
+    Interval x = num_args > 0 ? args[0] : ENTIRE;
+    Interval y = num_args > 1 ? args[1] : ENTIRE;
+
+    switch (op->id)
+    {
+        case ARITH_OP_ADD:
+            *out = interval_add(x, y);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_SUB:
+            *out = outward(x.lo - y.hi, x.hi - y.lo);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_MUL:
+            *out = interval_mul(x, y);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_DIV:
+            if (contains(y, 0))
+            {
+                *out_certain = is_point(y);
+                return LISTENERERR_DIVISION_BY_ZERO;
+            }
+            *out = interval_div(x, y);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_POW:
+            if (contains(x, 0) && y.lo <= 0)
+            {
+                *out_certain = is_point(x) && y.hi <= 0;
+                return LISTENERERR_DIVISION_BY_ZERO;
+            }
+            if (x.lo < 0 && y.lo < 1)
+            {
+                *out_certain = x.hi < 0 && y.hi < 1;
+                return LISTENERERR_COMPLEX_SOLUTION;
+            }
+            *out = interval_pow(x, y);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_PLUS:
+            *out = x;
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_NEG:
+            *out = exact(-x.hi, -x.lo);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_PERCENT:
+            *out = outward(x.lo / 100, x.hi / 100);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_EXP:
+            *out = increasing(exp, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ROOT:
+            if (x.lo < 0)
+            {
+                *out_certain = x.hi < 0;
+                return LISTENERERR_COMPLEX_SOLUTION;
+            }
+            *out = contains(y, 0) ? ENTIRE : interval_pow(x, interval_div((Interval){ 1, 1 }, y));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_SQRT:
+            if (x.lo < 0)
+            {
+                *out_certain = x.hi < 0;
+                return LISTENERERR_COMPLEX_SOLUTION;
+            }
+            *out = increasing(sqrt, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_LN:
+        case ARITH_OP_LD:
+        case ARITH_OP_LG:
+        {
+            double (*f)(double) = op->id == ARITH_OP_LN ? log : (op->id == ARITH_OP_LD ? log2 : log10);
+            *out = clip(&x, 0, INFINITY) ? increasing(f, x) : ENTIRE;
+            return LISTENERERR_SUCCESS;
+        }
+        case ARITH_OP_SIN:
+            *out = periodic(sin, PI / 2, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_COS:
+            *out = periodic(cos, 0, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_TAN:
+        {
+            // Increasing between poles at pi/2 + k*pi
+            double k = ceil((x.lo - PI / 2) / PI);
+            *out = (x.hi - x.lo < PI && PI / 2 + k * PI > x.hi + 1e-9) ? increasing(tan, x) : ENTIRE;
+            return LISTENERERR_SUCCESS;
+        }
+        case ARITH_OP_ASIN:
+            *out = clip(&x, -1, 1) ? increasing(asin, x) : ENTIRE;
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ACOS:
+            *out = clip(&x, -1, 1) ? outward(acos(x.hi), acos(x.lo)) : ENTIRE;
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ATAN:
+            *out = increasing(atan, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_SINH:
+            *out = increasing(sinh, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_COSH:
+            *out = contains(x, 0)
+                ? outward(1, cosh(fmax(-x.lo, x.hi)))
+                : outward(cosh(fmin(fabs(x.lo), fabs(x.hi))), cosh(fmax(fabs(x.lo), fabs(x.hi))));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_TANH:
+            *out = increasing(tanh, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ASINH:
+            *out = increasing(asinh, x);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ACOSH:
+            *out = clip(&x, 1, INFINITY) ? increasing(acosh, x) : ENTIRE;
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ATANH:
+            *out = clip(&x, -1, 1) ? increasing(atanh, x) : ENTIRE;
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ABS:
+            *out = contains(x, 0)
+                ? exact(0, fmax(-x.lo, x.hi))
+                : exact(fmin(fabs(x.lo), fabs(x.hi)), fmax(fabs(x.lo), fabs(x.hi)));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_CEIL:
+            *out = exact(ceil(x.lo), ceil(x.hi));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_FLOOR:
+            *out = exact(floor(x.lo), floor(x.hi));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_ROUND:
+            *out = exact(round(x.lo), round(x.hi));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_TRUNC:
+            *out = exact(trunc(x.lo), trunc(x.hi));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_FRAC:
+            *out = floor(x.lo) == floor(x.hi) ? outward(x.lo - floor(x.lo), x.hi - floor(x.hi)) : (Interval){ 0, 1 };
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_SGN:
+            *out = exact(x.lo < 0 ? -1 : (x.lo > 0), x.hi < 0 ? -1 : (x.hi > 0));
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_MAX:
+        case ARITH_OP_MIN:
+        {
+            // Empty max and min are -inf and inf, respectively
+            bool is_max = op->id == ARITH_OP_MAX;
+            *out = is_max ? (Interval){ -INFINITY, -INFINITY } : (Interval){ INFINITY, INFINITY };
+            for (size_t i = 0; i < num_args; i++)
+            {
+                *out = is_max
+                    ? (Interval){ fmax(out->lo, args[i].lo), fmax(out->hi, args[i].hi) }
+                    : (Interval){ fmin(out->lo, args[i].lo), fmin(out->hi, args[i].hi) };
+            }
+            return LISTENERERR_SUCCESS;
+        }
+        case ARITH_OP_SUM:
+        case ARITH_OP_AVG:
+            *out = (Interval){ 0, 0 };
+            for (size_t i = 0; i < num_args; i++) *out = interval_add(*out, args[i]);
+            if (op->id == ARITH_OP_AVG && num_args != 0) *out = outward(out->lo / num_args, out->hi / num_args);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_PROD:
+            *out = (Interval){ 1, 1 };
+            for (size_t i = 0; i < num_args; i++) *out = interval_mul(*out, args[i]);
+            return LISTENERERR_SUCCESS;
+        case ARITH_OP_VAR:
+        {
+            // Variance of values within [lo, hi] is at most (hi - lo)^2 / 4
+            if (num_args == 0) break;
+            Interval hull = args[0];
+            for (size_t i = 1; i < num_args; i++)
+            {
+                hull = (Interval){ fmin(hull.lo, args[i].lo), fmax(hull.hi, args[i].hi) };
+            }
+            double width = hull.hi - hull.lo;
+            *out = outward(0, width * width / 4);
+            out->lo = 0;
+            return LISTENERERR_SUCCESS;
+        }
+        case ARITH_OP_RAND:
+        {
+            // Integer between truncated bounds, upper one is exclusive. Empty range gives -1.
+            if (!is_point(x) || !is_point(y))
+            {
+                *out = ENTIRE;
+                return LISTENERERR_SUCCESS;
+            }
+            double min = trunc(x.lo);
+            double max = trunc(y.lo);
+            *out = max - min < 1 ? (Interval){ -1, -1 } : exact(min, max - 1);
+            return LISTENERERR_SUCCESS;
+        }
+    }
+
+    // Other operators are only evaluated for points
+    for (size_t i = 0; i < num_args; i++)
+    {
+        if (!is_point(args[i]))
+        {
+            *out = ENTIRE;
+            return LISTENERERR_SUCCESS;
+        }
+    }
+    double inline_args[INLINE_ARGS];
+    double *points = num_args <= INLINE_ARGS ? inline_args : malloc_wrapper(num_args * sizeof(double));
+    for (size_t i = 0; i < num_args; i++) points[i] = args[i].lo;
+    double res;
+    ListenerError err = arith_op_evaluate(op, num_args, points, &res);
+    if (points != inline_args) free(points);
+    if (err != LISTENERERR_SUCCESS)
+    {
+        *out_certain = true;
+        return err;
+    }
+    // Value of an impure operator (e.g. history) is not guaranteed, only its error is
+    *out = op->pure ? exact(res, res) : ENTIRE;
+    return LISTENERERR_SUCCESS;
+}
+
+/*
+Summary: Computes bounds of tree for all values of var within value
+Params
+    out:         Contains result of every point of value for which evaluation succeeds
+    out_certain: When an error is returned, true if it occurs for every point and false if only for some of them
+Returns: First error in evaluation order that may occur, LISTENERERR_SUCCESS if evaluation of every point succeeds
+    LISTENERERR_VARIABLE_ENCOUNTERED if tree contains another variable than var
+*/
+ListenerError interval_evaluate(const Node *tree, const char *var, Interval value, Interval *out, bool *out_certain)
+{
+    switch (get_type(tree))
+    {
+        case NTYPE_CONSTANT:
+            *out = (Interval){ get_const_value(tree), get_const_value(tree) };
+            return LISTENERERR_SUCCESS;
+
+        case NTYPE_VARIABLE:
+            if (var == NULL || strcmp(get_var_name(tree), var) != 0)
+            {
+                *out_certain = true;
+                return LISTENERERR_VARIABLE_ENCOUNTERED;
+            }
+            *out = value;
+            return LISTENERERR_SUCCESS;
+
+        case NTYPE_OPERATOR:
+        {
+            size_t num_children = get_num_children(tree);
+            Interval inline_args[INLINE_ARGS];
+            Interval *args = num_children <= INLINE_ARGS ? inline_args : malloc_wrapper(num_children * sizeof(Interval));
+
+            ListenerError err = LISTENERERR_SUCCESS;
+            for (size_t i = 0; i < num_children && err == LISTENERERR_SUCCESS; i++)
+            {
+                err = interval_evaluate(get_child(tree, i), var, value, args + i, out_certain);
+            }
+            if (err == LISTENERERR_SUCCESS) err = apply(get_op(tree), num_children, args, out, out_certain);
+
+            if (args != inline_args) free(args);
+            return err;
+        }
+    }
+    return LISTENERERR_SUCCESS;
+}
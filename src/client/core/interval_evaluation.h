@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+#include "../../engine/tree/node.h"
+#include "../../engine/tree/tree_util.h"
+
+/*
+Interval evaluation: An expression is evaluated for all values of a variable within an interval at once.
+Bounds are rounded outwards, so that they contain the result of every point of the interval.
+Points whose result is NaN (e.g. ln of a negative number) are not covered.
+*/
+
+typedef struct
+{
+    double lo;
+    double hi;
+} Interval;
+
+ListenerError interval_evaluate(const Node *tree, const char *var, Interval value, Interval *out, bool *out_certain);
@@ -0,0 +1,145 @@
+#include "../../util/alloc_wrappers.h"
+#include "session.h"
+#include "arith_evaluation.h"
+
+#define HISTORY_STARTSIZE 8
+
+static Session default_session = {
+    .history   = { sizeof(double), 0, 0, NULL },
+    .rng_state = { 0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull, 0x94D049BB133111EBull, 1 },
+    .rng_lock  = PTHREAD_MUTEX_INITIALIZER
+};
+
+static pthread_key_t session_key;
+static pthread_once_t session_once = PTHREAD_ONCE_INIT;
+
+static void create_session_key()
+{
+    pthread_key_create(&session_key, NULL);
+}
+
+Session *session_create(uint64_t seed)
+{
+    Session *res = malloc_wrapper(sizeof(Session));
+    res->history = vec_create(sizeof(double), HISTORY_STARTSIZE);
+    pthread_mutex_init(&res->rng_lock, NULL);
+    session_seed(res, seed);
+    return res;
+}
+
+void session_free(Session *session)
+{
+    vec_destroy(&session->history);
+    pthread_mutex_destroy(&session->rng_lock);
+    free(session);
+}
+
+/*
+Summary: Session of the process, which is used by threads that have not bound one
+*/
+Session *session_default()
+{
+    return &default_session;
+}
+
+Session *session_current()
+{
+    pthread_once(&session_once, create_session_key);
+    Session *res = pthread_getspecific(session_key);
+    return res != NULL ? res : &default_session;
+}
+
+/*
+Summary: Binds session to calling thread, NULL to use the default session again
+*/
+void session_bind(Session *session)
+{
+    pthread_once(&session_once, create_session_key);
+    pthread_setspecific(session_key, session);
+}
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/*
+Summary: Same seed gives same sequence of random numbers. State is expanded by SplitMix64, thus it is never all zero.
+*/
+void session_seed(Session *session, uint64_t seed)
+{
+    pthread_mutex_lock(&session->rng_lock);
+    for (size_t i = 0; i < 4; i++) session->rng_state[i] = splitmix64(&seed);
+    pthread_mutex_unlock(&session->rng_lock);
+}
+
+/*
+Summary: Next number of the session's generator (xoshiro256**)
+*/
+uint64_t session_random(Session *session)
+{
+    pthread_mutex_lock(&session->rng_lock);
+    uint64_t *s = session->rng_state;
+    uint64_t res = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    pthread_mutex_unlock(&session->rng_lock);
+    return res;
+}
+
+/*
+Summary: Uniformly distributed number in [0, bound). Numbers below 2^64 mod bound are rejected,
+    so that the remaining range is a multiple of bound and the result is free of modulo bias.
+*/
+uint64_t session_random_below(Session *session, uint64_t bound)
+{
+    if (bound == 0) return 0;
+    uint64_t threshold = -bound % bound;
+    uint64_t res;
+    do
+    {
+        res = session_random(session);
+    } while (res < threshold);
+    return res % bound;
+}
+
+void session_history_add(Session *session, double value)
+{
+    VEC_PUSH_ELEM(&session->history, double, value);
+}
+
+/*
+Params
+    index: 0 -> last evaluation, 1 -> second last evaluation etc.
+*/
+bool session_history_get(const Session *session, size_t index, double *out)
+{
+    if (vec_count(&session->history) <= index) return false;
+    *out = *(double*)vec_get(&session->history, vec_count(&session->history) - 1 - index);
+    return true;
+}
+
+/*
+Summary: Evaluates tree within session, which is bound to calling thread for the duration of the evaluation
+*/
+ListenerError session_evaluate(Session *session, const Node *tree, double *out)
+{
+    Session *previous = session_current();
+    session_bind(session);
+    ListenerError err = tree_reduce(tree, arith_op_evaluate, out, NULL);
+    session_bind(previous == &default_session ? NULL : previous);
+    return err;
+}
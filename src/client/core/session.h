@@ -0,0 +1,37 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "../../util/vector.h"
+#include "../../engine/tree/node.h"
+#include "../../engine/tree/tree_util.h"
+
+/*
+Session: Mutable state that evaluation depends on, i.e. history and random numbers.
+Evaluation uses the session that is bound to the calling thread, or the default session of the process.
+Parsing context and user-defined functions are shared by all sessions and are only read while evaluating.
+Rulesets are shared as well and guarded by a lock. While the profiler collects rule statistics or reorders rules,
+simplifications hold it exclusively and are executed one after another.
+Options of the set command (e.g. compensated evaluation, e-graph, step and time budgets) are process-wide globals.
+They must not be changed while other threads evaluate.
+*/
+
+typedef struct
+{
+    Vector history;           // Results of last evaluations (doubles)
+    uint64_t rng_state[4];    // Of xoshiro256**, seeded by SplitMix64
+    pthread_mutex_t rng_lock; // Workers of a parallel simplification bind the session of the simplifying thread
+} Session;
+
+Session *session_create(uint64_t seed);
+void session_free(Session *session);
+Session *session_default();
+Session *session_current();
+void session_bind(Session *session);
+
+void session_seed(Session *session, uint64_t seed);
+uint64_t session_random(Session *session);
+uint64_t session_random_below(Session *session, uint64_t bound);
+void session_history_add(Session *session, double value);
+bool session_history_get(const Session *session, size_t index, double *out);
+ListenerError session_evaluate(Session *session, const Node *tree, double *out);
@@ -2,13 +2,16 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
 
 #include "../util/trie.h"
 #include "../util/console_util.h"
 #include "commands/commands.h"
+#include "core/session.h"
 #include "version.h"
 
-#define HELP_MESSAGE "Usage: ccalc [--help] [--version] [--interactive] [--quiet] [--commands [<commands>]]\n" \
+#define HELP_MESSAGE "Usage: ccalc [--help] [--version] [--interactive] [--quiet] [--seed <n>] [--commands [<commands>]]\n" \
                      "Each switch can be abbreviated by -h, -v etc.\n"
 
 /*
@@ -53,6 +56,8 @@ int main(int argc, char **argv)
     bool help;
     bool version;
     bool commands;
+    bool seeded;
+    uint64_t seed = 0;
     int commands_index = -1;
     add_switch(&switches, "--interactive", &force_interactive);
     add_switch(&switches, "-i", &force_interactive);
@@ -62,6 +67,8 @@ int main(int argc, char **argv)
     add_switch(&switches, "-h", &help);
     add_switch(&switches, "--version", &version);
     add_switch(&switches, "-v", &version);
+    add_switch(&switches, "--seed", &seeded);
+    add_switch(&switches, "-s", &seeded);
     add_switch(&switches, "--commands", &commands);
     add_switch(&switches, "-c", &commands);
     for (int i = 1; i < argc; i++)
@@ -72,6 +79,21 @@ int main(int argc, char **argv)
             commands_index = i;
             break;
         }
+        if (sw == &seeded)
+        {
+            // Seed is next argument, a non-negative decimal integer that fits into 64 bits
+            char *end = NULL;
+            errno = 0;
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) seed = strtoull(argv[i + 1], &end, 10);
+            if (end == NULL || *end != '\0' || errno == ERANGE)
+            {
+                report_error("Expected seed after %s\n" HELP_MESSAGE, argv[i]);
+                trie_destroy(&switches);
+                return EXIT_FAILURE;
+            }
+            i++;
+            continue;
+        }
         if (sw == NULL)
         {
             report_error("Unrecognized argument: %s\n" HELP_MESSAGE, argv[i]);
@@ -108,6 +130,8 @@ int main(int argc, char **argv)
     // Since we know that we parse commands or enter interactive mode, build arithmetic context and initialize commands
     init_commands();
     atexit(unload_commands);
+    // Random numbers are reproducible when seeded, otherwise the seed is based on time
+    if (seeded) session_seed(session_default(), seed);
     
     // Parse supplied commands non-interactively
     if (commands_index != -1)
@@ -12,56 +12,53 @@
 #define EVAL_TRUE       1
 #define EVAL_FALSE      0
 
-ListenerError prop_op_evaluate(const Operator *op, size_t num_args, const double *args, double *out)
-{
-    // Propositional context is an extension of the arithmetic context
-    if (op->id < NUM_ARITH_OPS) return arith_op_evaluate(op, num_args, args, out);
-
-    switch (op->id)
-    {
-        case NUM_ARITH_OPS + 2: // ==
-            *out = (args[0] == args[1]) ? EVAL_TRUE : EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 3: // !=
-            *out = (args[0] != args[1]) ? EVAL_TRUE : EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 4: // CONST
-            *out = EVAL_TYPE_CONST;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 5: // VAR
-            *out = EVAL_TYPE_VAR;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 6: // OP
-            *out = EVAL_TYPE_OP;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 7: // >
-            *out = (args[0] > args[1]) ? EVAL_TRUE : EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 8: // <
-            *out = (args[0] < args[1]) ? EVAL_TRUE : EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 9: // >=
-            *out = (args[0] >= args[1]) ? EVAL_TRUE : EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 10: // <=
-            *out = (args[0] <= args[1]) ? EVAL_TRUE : EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 11: // ||
-            *out = (args[0] != EVAL_FALSE || args[1] != EVAL_FALSE) ? EVAL_TRUE : EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 12: // TRUE
-            *out = EVAL_TRUE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 13: // FALSE
-            *out = EVAL_FALSE;
-            return LISTENERERR_SUCCESS;
-        case NUM_ARITH_OPS + 14: // !
-            *out = (args[0] != EVAL_FALSE) ? EVAL_FALSE : EVAL_TRUE;
-            return LISTENERERR_SUCCESS;
+// Defines evaluation of a propositional operator, see EVALUATION in arith_evaluation.c
+#define PROP_EVALUATION(name, expr)\
+    static ListenerError name(__attribute__((unused)) size_t num_args,\
+        __attribute__((unused)) const double *args,\
+        double *out)\
+    {\
+        *out = (expr);\
+        return LISTENERERR_SUCCESS;\
     }
 
-    software_defect("[Prop] No reduction possible for operator %s.\n", op->name);
-    return LISTENERERR_UNKNOWN_OP; // To make compiler happy
+PROP_EVALUATION(eval_eq,    (args[0] == args[1]) ? EVAL_TRUE : EVAL_FALSE)
+PROP_EVALUATION(eval_neq,   (args[0] != args[1]) ? EVAL_TRUE : EVAL_FALSE)
+PROP_EVALUATION(eval_const, EVAL_TYPE_CONST)
+PROP_EVALUATION(eval_var,   EVAL_TYPE_VAR)
+PROP_EVALUATION(eval_op,    EVAL_TYPE_OP)
+PROP_EVALUATION(eval_gt,    (args[0] > args[1]) ? EVAL_TRUE : EVAL_FALSE)
+PROP_EVALUATION(eval_lt,    (args[0] < args[1]) ? EVAL_TRUE : EVAL_FALSE)
+PROP_EVALUATION(eval_ge,    (args[0] >= args[1]) ? EVAL_TRUE : EVAL_FALSE)
+PROP_EVALUATION(eval_le,    (args[0] <= args[1]) ? EVAL_TRUE : EVAL_FALSE)
+PROP_EVALUATION(eval_or,    (args[0] != EVAL_FALSE || args[1] != EVAL_FALSE) ? EVAL_TRUE : EVAL_FALSE)
+PROP_EVALUATION(eval_true,  EVAL_TRUE)
+PROP_EVALUATION(eval_false, EVAL_FALSE)
+PROP_EVALUATION(eval_not,   (args[0] != EVAL_FALSE) ? EVAL_FALSE : EVAL_TRUE)
+
+// Extension of arithmetic context. type and equal are reduced on trees by propositional_checker, count by rules
+static const OpDescriptor PROP_OPS[NUM_PROPOSITIONAL_OPS] = {
+    { "type",  OP_PLACE_FUNCTION, 1,                0, OP_ASSOC_LEFT, NULL,       false },
+    { "equal", OP_PLACE_FUNCTION, 2,                0, OP_ASSOC_LEFT, NULL,       false },
+    { "==",    OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT, eval_eq,    true  },
+    { "!=",    OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT, eval_neq,   true  },
+    { "CONST", OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT, eval_const, true  },
+    { "VAR",   OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT, eval_var,   true  },
+    { "OP",    OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT, eval_op,    true  },
+    { ">",     OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT, eval_gt,    true  },
+    { "<",     OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT, eval_lt,    true  },
+    { ">=",    OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT, eval_ge,    true  },
+    { "<=",    OP_PLACE_INFIX,    2,                1, OP_ASSOC_LEFT, eval_le,    true  },
+    { "||",    OP_PLACE_INFIX,    2,                0, OP_ASSOC_LEFT, eval_or,    true  },
+    { "TRUE",  OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT, eval_true,  true  },
+    { "FALSE", OP_PLACE_FUNCTION, 0,                0, OP_ASSOC_LEFT, eval_false, true  },
+    { "!",     OP_PLACE_PREFIX,   1,                4, OP_ASSOC_LEFT, eval_not,   true  },
+    { "count", OP_PLACE_FUNCTION, OP_DYNAMIC_ARITY, 0, OP_ASSOC_LEFT, NULL,       false },
+};
+
+Operator prop_get_op(size_t index)
+{
+    return op_from_descriptor(&PROP_OPS[index]);
 }
 
 double equal_eval(__attribute__((unused)) size_t num_children, Node **children)
@@ -92,7 +89,7 @@ bool propositional_checker(Node **tree)
     tree_reduce_ops(tree, ctx_lookup_op(g_propositional_ctx, "equal", OP_PLACE_FUNCTION), equal_eval);
     // Step 3: Reduce everything else
     double reduced = 0;
-    if (tree_reduce(*tree, prop_op_evaluate, &reduced, NULL) != LISTENERERR_SUCCESS)
+    if (tree_reduce(*tree, arith_op_evaluate, &reduced, NULL) != LISTENERERR_SUCCESS)
     {
         return false;
     }
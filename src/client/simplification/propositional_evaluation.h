@@ -4,5 +4,7 @@
 #include "../../engine/tree/node.h"
 #include "../../engine/tree/tree_util.h"
 
-ListenerError prop_op_evaluate(const Operator *op, size_t num_args, const double *args, double *out);
+#define NUM_PROPOSITIONAL_OPS 16
+
+Operator prop_get_op(size_t index);
 bool propositional_checker(Node **tree);
@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200112L // For pthread_rwlock_t
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
@@ -6,19 +7,31 @@
 #include "../../engine/tree/tree_util.h"
 #include "../../engine/tree/tree_to_string.h"
 #include "../../engine/transformation/rewrite_rule.h"
+#include "../../engine/transformation/egraph.h"
 #include "../../engine/transformation/rule_parsing.h"
 #include "../../engine/parsing/parser.h"
 #include "../../util/console_util.h"
 #include "../../util/linked_list.h"
+#include "../../table/table.h"
 
 #include "../core/arith_context.h"
 #include "../core/arith_evaluation.h"
+#include "../core/session.h"
 #include "simplification.h"
 #include "propositional_context.h"
 #include "propositional_evaluation.h"
+#include "../core/compensated_evaluation.h"
 
 #define P(x) (parse_easy(g_ctx, x))
 #define NUM_RULESETS 7
+#define NF_CACHE_SIZE 1024
+#define EGRAPH_RULESET 3
+#define FOLDING_RULESET 4 // This and later rulesets turn normal forms into output, they are not cut off by deadline
+#define EGRAPH_MAX_ENODES 5000
+#define EGRAPH_MAX_ITERATIONS 30
+#define EGRAPH_MAX_MILLIS 200 // Saturation is cut off earlier when deadline of simplification is closer
+#define DEFAULT_MAX_STEPS  MAX_RULESET_ITERATIONS
+#define DEFAULT_MAX_MILLIS 0
 
 /*
 Rulesets: 1. Elimination
@@ -30,8 +43,45 @@ Rulesets: 1. Elimination
           7. Ordering
 */
 
+static const char *ruleset_names[NUM_RULESETS] = {
+    "Elimination",
+    "Derivation",
+    "Normal form",
+    "Simplification",
+    "Folding",
+    "Prettify",
+    "Ordering"
+};
+
 bool initialized = false;
 Vector rulesets[NUM_RULESETS];
+// Simplifications read rulesets concurrently, loading them and collecting rule statistics is exclusive
+pthread_rwlock_t rulesets_lock = PTHREAD_RWLOCK_INITIALIZER;
+NormalFormCache nf_cache; // Normal forms are only valid as long as rulesets are loaded
+bool use_egraph = false;  // Main simplification by equality saturation instead of ordered rewriting
+bool use_parallel = false;
+ThreadPool *pool = NULL;  // Created when needed for parallel normalization
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+size_t max_steps = DEFAULT_MAX_STEPS;   // Of each ruleset appliance
+size_t max_millis = DEFAULT_MAX_MILLIS; // Of whole simplification, 0 for no limit
+
+// State of one simplification, so that threads can simplify concurrently
+typedef struct
+{
+    TreeListener folder;  // Keeps random numbers if requested
+    RewriteBudget budget; // Deadline is set when simplification starts
+} SimplificationContext;
+
+// Normal form and folding are confluent enough to normalize subtrees independently of each other
+static const RewriteStrategy strategies[NUM_RULESETS] = {
+    STRATEGY_TOP_DOWN,
+    STRATEGY_TOP_DOWN,
+    STRATEGY_BOTTOM_UP,
+    STRATEGY_TOP_DOWN,
+    STRATEGY_BOTTOM_UP,
+    STRATEGY_TOP_DOWN,
+    STRATEGY_TOP_DOWN
+};
 
 Pattern deriv_before;
 Node *deriv_after;
@@ -77,6 +127,7 @@ ssize_t init_simplification(const char *ruleset_path)
 
     if (ruleset_file == NULL) return -1;
 
+    pthread_rwlock_wrlock(&rulesets_lock);
     for (size_t i = 0; i < NUM_RULESETS; i++)
     {
         rulesets[i] = get_empty_ruleset();
@@ -84,15 +135,18 @@ ssize_t init_simplification(const char *ruleset_path)
     ssize_t num_rulesets = parse_rulesets_from_file(ruleset_file, g_propositional_ctx, NUM_RULESETS, rulesets);
     if (num_rulesets == -1)
     {
+        pthread_rwlock_unlock(&rulesets_lock);
         return -2;
     }
     if (num_rulesets != NUM_RULESETS)
     {
         report_error("Too few simplification rulesets defined in %s.\n", ruleset_path);
+        pthread_rwlock_unlock(&rulesets_lock);
         return -2;
     }
     fclose(ruleset_file);
 
+    nf_cache = nfcache_create(NF_CACHE_SIZE);
     get_pattern(P("x'"), 0, NULL, &deriv_before);
     deriv_after = P("deriv(x, z)");
     parse_pattern("deriv(x, y) WHERE type(y) != VAR", g_propositional_ctx, &malformed_deriv);
@@ -104,34 +158,203 @@ ssize_t init_simplification(const char *ruleset_path)
     {
         res += vec_count(rulesets + i);
     }
+    pthread_rwlock_unlock(&rulesets_lock);
     return res;
 }
 
 void unload_simplification()
 {
-    if (!initialized) return;
+    pthread_rwlock_wrlock(&rulesets_lock);
+    if (!initialized)
+    {
+        pthread_rwlock_unlock(&rulesets_lock);
+        return;
+    }
     free_pattern(&deriv_before);
     free_tree(deriv_after);
     free_pattern(&malformed_deriv);
+    nfcache_destroy(&nf_cache);
+    pool_destroy(pool);
+    pool = NULL;
     for (size_t i = 0; i < NUM_RULESETS; i++)
     {
         free_ruleset(&rulesets[i]);
     }
     initialized = false;
+    pthread_rwlock_unlock(&rulesets_lock);
 }
 
-static void apply_simplification(Node **tree, Vector *ruleset)
+// Folding of these operators depends on state, so normal forms of trees containing them must not be cached
+static bool is_cacheable(const Node *tree)
 {
-    VectorIterator it = vec_get_iterator(ruleset);
-    while (apply_ruleset_by_iterator(tree, (Iterator*)&it, propositional_checker, 1) != 0)
+    return find_op(&tree, ctx_lookup_op(g_ctx, "rand", OP_PLACE_FUNCTION)) == NULL
+        && find_op(&tree, ctx_lookup_op(g_ctx, "@", OP_PLACE_PREFIX)) == NULL
+        && find_op(&tree, ctx_lookup_op(g_ctx, "ans", OP_PLACE_FUNCTION)) == NULL;
+}
+
+/*
+Summary: Prints statistics of every rule that has been tried since profiler was enabled or reset
+*/
+void print_rule_statistics()
+{
+    pthread_rwlock_rdlock(&rulesets_lock);
+    if (!initialized)
     {
-        iterator_reset((Iterator*)&it);
-        tree_reduce_constant_subtrees(tree, arith_op_evaluate, NULL);
-    };
+        pthread_rwlock_unlock(&rulesets_lock);
+        return;
+    }
+
+    Table *table = get_empty_table();
+    set_default_alignments(table, 6,
+        (TableHAlign[]){ H_ALIGN_LEFT, H_ALIGN_LEFT, H_ALIGN_RIGHT, H_ALIGN_RIGHT, H_ALIGN_RIGHT, H_ALIGN_RIGHT },
+        NULL);
+    override_horizontal_alignment_of_row(table, H_ALIGN_LEFT);
+    add_cells(table, 6, " Ruleset ", " Rule ", " Attempts ", " Hits ", " Partial matchings ", " Time [ms] ");
+    next_row(table);
+
+    for (size_t i = 0; i < NUM_RULESETS; i++)
+    {
+        for (size_t j = 0; j < vec_count(rulesets + i); j++)
+        {
+            RewriteRule *rule = (RewriteRule*)vec_get(rulesets + i, j);
+            if (rule->stats->attempts == 0) continue;
+
+            add_cell_fmt(table, " %s ", ruleset_names[i]);
+            char *pattern = tree_to_str(rule->pattern.pattern, false);
+            add_cell_fmt(table, " %s ", pattern);
+            free(pattern);
+            add_cell_fmt(table, " %zu ", rule->stats->attempts);
+            add_cell_fmt(table, " %zu ", rule->stats->successes);
+            add_cell_fmt(table, " %zu ", rule->stats->partial_matchings);
+            add_cell_fmt(table, " %.3f ", rule->stats->nanos / 1e6);
+            next_row(table);
+        }
+    }
+    pthread_rwlock_unlock(&rulesets_lock);
+
+    print_table(table);
+    free_table(table);
+}
+
+void reset_rule_statistics()
+{
+    pthread_rwlock_wrlock(&rulesets_lock);
+    for (size_t i = 0; i < NUM_RULESETS && initialized; i++)
+    {
+        for (size_t j = 0; j < vec_count(rulesets + i); j++)
+        {
+            *((RewriteRule*)vec_get(rulesets + i, j))->stats = (RuleStats){ 0 };
+        }
+    }
+    pthread_rwlock_unlock(&rulesets_lock);
+}
+
+/*
+Summary: Enables or disables equality saturation for main simplification ruleset
+*/
+void set_egraph_simplification(bool value)
+{
+    use_egraph = value;
+}
+
+/*
+Summary: Enables or disables concurrent normalization of independent subtrees for bottom-up rulesets
+*/
+void set_parallel_simplification(bool value)
+{
+    use_parallel = value;
+}
+
+/*
+Summary: Sets maximum number of rule appliances per ruleset. When exceeded, the best tree found so far is kept
+*/
+void set_simplification_step_budget(size_t value)
+{
+    max_steps = value;
+}
+
+/*
+Summary: Sets maximum wall-clock time of a simplification in milliseconds, 0 for no limit
+*/
+void set_simplification_time_budget(size_t value)
+{
+    max_millis = value;
+}
+
+// Workers of the pool evaluate with the session of the simplifying thread
+static void *capture_session()
+{
+    return session_current();
+}
+
+static void adopt_session(void *session)
+{
+    session_bind((Session*)session);
+}
+
+static ThreadPool *get_pool()
+{
+    pthread_mutex_lock(&pool_lock);
+    if (pool == NULL)
+    {
+        pool = pool_create(sysconf(_SC_NPROCESSORS_ONLN));
+        pool_set_hooks(pool, capture_session, adopt_session);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return pool;
+}
+
+static void apply_simplification(const SimplificationContext *context, Node **tree, size_t ruleset_index)
+{
+    // When time is up, the partial result is still shown in user-facing form
+    RewriteBudget ruleset_budget = ruleset_index >= FOLDING_RULESET
+        ? get_budget(context->budget.max_steps, 0)
+        : context->budget;
+    if (use_parallel && strategies[ruleset_index] == STRATEGY_BOTTOM_UP)
+    {
+        apply_ruleset_bottom_up_parallel(tree,
+            rulesets + ruleset_index,
+            propositional_checker,
+            context->folder,
+            is_cacheable(*tree) ? &nf_cache : NULL,
+            ruleset_budget,
+            get_pool());
+        replace_negative_consts(tree);
+        return;
+    }
+
+    // Saturation can be cut off by its limits, so it only replaces result of ordered rewriting if it is smaller
+    Node *saturated = use_egraph && ruleset_index == EGRAPH_RULESET ? tree_copy(*tree) : NULL;
+
+    apply_ruleset(tree,
+        rulesets + ruleset_index,
+        strategies[ruleset_index],
+        propositional_checker,
+        context->folder,
+        is_cacheable(*tree) ? &nf_cache : NULL,
+        ruleset_budget);
+
+    if (saturated != NULL)
+    {
+        SaturationLimits limits = {
+            .max_enodes     = EGRAPH_MAX_ENODES,
+            .max_iterations = EGRAPH_MAX_ITERATIONS,
+            .deadline       = fmin(context->budget.deadline, get_budget(SIZE_MAX, EGRAPH_MAX_MILLIS).deadline)
+        };
+        apply_ruleset_saturating(&saturated, rulesets + ruleset_index, propositional_checker, context->folder, limits);
+        if (tree_count_nodes(saturated) < tree_count_nodes(*tree))
+        {
+            tree_replace(tree, saturated);
+        }
+        else
+        {
+            free_tree(saturated);
+        }
+    }
     replace_negative_consts(tree);
 }
 
-ListenerError apply_derivatives(Node **tree, const Node **errnode)
+static ListenerError apply_derivatives(const SimplificationContext *context, Node **tree, const Node **errnode)
 {
     Matching matching;
     Node **matched;
@@ -143,6 +366,7 @@ ListenerError apply_derivatives(Node **tree, const Node **errnode)
         size_t var_count = list_variables(*matched, 2, vars, NULL);
         if (var_count > 1)
         {
+            free_matching(&matching);
             if (errnode != NULL) *errnode = *matched;
             return LISTENERERR_MALFORMED_DERIV_A;
         }
@@ -155,18 +379,20 @@ ListenerError apply_derivatives(Node **tree, const Node **errnode)
             tree_replace(get_child_addr(replacement, 1), malloc_variable_node(vars[0], 0, 0));
         }
 
-        tree_replace(get_child_addr(replacement, 0), tree_copy(matching.mapped_nodes[0].nodes[0]));
+        tree_replace(get_child_addr(replacement, 0), tree_copy(get_mapped_nodes(&matching, 0)->nodes[0]));
         tree_replace(matched, replacement);
+        free_matching(&matching);
     }
 
     // Check for deriv(x, y) WHERE !(type(y) == VAR)
     if ((matched = find_matching((const Node**)tree, &malformed_deriv, propositional_checker, &matching)) != NULL)
     {
+        free_matching(&matching);
         if (errnode != NULL) *errnode = *matched;
         return LISTENERERR_MALFORMED_DERIV_B;
     }
 
-    apply_simplification(tree, rulesets + 1);
+    apply_simplification(context, tree, 1);
 
     // If the tree still contains deriv-operators, the user attempted to derivate 
     // a subtree for which no reduction rule exists.
@@ -180,14 +406,89 @@ ListenerError apply_derivatives(Node **tree, const Node **errnode)
     return LISTENERERR_SUCCESS;
 }
 
-void simplify_without_derivative(Node **tree)
+static void simplify_without_derivative(const SimplificationContext *context, Node **tree)
 {
-    apply_simplification(tree, rulesets + 0);
-    apply_simplification(tree, rulesets + 2);
-    apply_simplification(tree, rulesets + 3);
-    apply_simplification(tree, rulesets + 4);
-    apply_simplification(tree, rulesets + 5);
-    apply_simplification(tree, rulesets + 6);
+    apply_simplification(context, tree, 0);
+    apply_simplification(context, tree, 2);
+    apply_simplification(context, tree, 3);
+    apply_simplification(context, tree, 4);
+    apply_simplification(context, tree, 5);
+    apply_simplification(context, tree, 6);
+}
+
+// Like arith_op_evaluate, but no random number is drawn, so that rand remains in the tree
+static ListenerError evaluate_deterministic(const Operator *op, size_t num_args, const double *args, double *out)
+{
+    if (op->id == ARITH_OP_RAND) return LISTENERERR_VARIABLE_ENCOUNTERED;
+    return arith_op_evaluate(op, num_args, args, out);
+}
+
+// Constant subtrees of input and result are evaluated compensated if enabled, folding rules always use double
+static ListenerError reduce_constant_subtrees(const SimplificationContext *context, Node **tree, const Node **errnode)
+{
+    if (get_compensated_evaluation())
+    {
+        return dd_reduce_constant_subtrees(tree, context->folder == arith_op_evaluate, errnode);
+    }
+    return tree_reduce_constant_subtrees(tree, context->folder, errnode);
+}
+
+// Applies rulesets, caller holds lock of rulesets
+static ListenerError apply_rulesets(const SimplificationContext *context, Node **tree, bool derivatives,
+    const Node **errnode)
+{
+    // Apply elimination rules
+    simplify_without_derivative(context, tree);
+    if (derivatives)
+    {
+        ListenerError res = apply_derivatives(context, tree, errnode);
+        if (res != LISTENERERR_SUCCESS) return res;
+        simplify_without_derivative(context, tree);
+    }
+    return LISTENERERR_SUCCESS;
+}
+
+static ListenerError simplify_impl(Node **tree, bool derivatives, bool random, const Node **errnode)
+{
+    SimplificationContext context = {
+        .folder = random ? arith_op_evaluate : evaluate_deterministic
+    };
+    ListenerError res = reduce_constant_subtrees(&context, tree, errnode);
+
+    // Rule statistics are not synchronized, simplification is exclusive while they are collected
+    if (profiler_is_enabled() || profiler_is_adaptive())
+    {
+        pthread_rwlock_wrlock(&rulesets_lock);
+    }
+    else
+    {
+        pthread_rwlock_rdlock(&rulesets_lock);
+    }
+
+    // It's okay if simplification module is not initialized, just return without doing much
+    if (!initialized)
+    {
+        pthread_rwlock_unlock(&rulesets_lock);
+        return res;
+    }
+
+    context.budget = get_budget(max_steps, max_millis);
+    if (profiler_is_adaptive())
+    {
+        for (size_t i = 0; i < NUM_RULESETS; i++)
+        {
+            reorder_ruleset(rulesets + i);
+        }
+    }
+    res = apply_rulesets(&context, tree, derivatives, errnode);
+    pthread_rwlock_unlock(&rulesets_lock);
+    if (res != LISTENERERR_SUCCESS) return res;
+
+    res = reduce_constant_subtrees(&context, tree, errnode);
+    if (res != LISTENERERR_SUCCESS) return res;
+    replace_negative_consts(tree);
+
+    return LISTENERERR_SUCCESS;
 }
 
 /*
@@ -199,20 +500,21 @@ Returns: True when transformations could be applied, False otherwise
 */
 ListenerError simplify(Node **tree, const Node **errnode)
 {
-    ListenerError res = tree_reduce_constant_subtrees(tree, arith_op_evaluate, errnode);
-
-    // It's okay if simplification module is not initialized, just return without doing much
-    if (!initialized) return res;
-
-    // Apply elimination rules
-    simplify_without_derivative(tree);
-    res = apply_derivatives(tree, errnode);
-    if (res != LISTENERERR_SUCCESS) return res;
-    simplify_without_derivative(tree);
+    return simplify_impl(tree, true, true, errnode);
+}
 
-    res = tree_reduce_constant_subtrees(tree, arith_op_evaluate, errnode);
-    if (res != LISTENERERR_SUCCESS) return res;
-    replace_negative_consts(tree);
+/*
+Summary: Like simplify, but derivatives are kept, so that they can be evaluated numerically by dual_evaluate
+*/
+ListenerError simplify_keeping_derivatives(Node **tree, const Node **errnode)
+{
+    return simplify_impl(tree, false, true, errnode);
+}
 
-    return LISTENERERR_SUCCESS;
+/*
+Summary: Like simplify, but random numbers are not drawn, so that their whole range can be considered afterwards
+*/
+ListenerError simplify_keeping_random(Node **tree, const Node **errnode)
+{
+    return simplify_impl(tree, true, false, errnode);
 }
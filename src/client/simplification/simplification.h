@@ -7,4 +7,12 @@
 bool simplification_is_initialized();
 ssize_t init_simplification(const char *file);
 void unload_simplification();
+void set_egraph_simplification(bool value);
+void set_parallel_simplification(bool value);
+void set_simplification_step_budget(size_t value);
+void set_simplification_time_budget(size_t value);
+void print_rule_statistics();
+void reset_rule_statistics();
 ListenerError simplify(Node **tree, const Node **errnode);
+ListenerError simplify_keeping_derivatives(Node **tree, const Node **errnode);
+ListenerError simplify_keeping_random(Node **tree, const Node **errnode);
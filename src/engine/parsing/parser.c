@@ -5,8 +5,11 @@
 #include "parser.h"
 #include "../util/string_util.h"
 #include "../util/console_util.h"
+#include "../util/alloc_wrappers.h"
+#include "../tree/tree_util.h"
 
 #define VECTOR_STARTSIZE 10
+#define FOLD_INLINE_ARGS 8 // Operands of folded operators with fewer children are held on call stack
 
 // Do not use this macro in auxiliary functions!
 #define ERROR(type) {\
@@ -30,6 +33,7 @@ struct ParserState
     Vector vec_ops;            // Parsed operators
     ParserError result;        // Success when no error occurred
     size_t curr_tok;           // Current index of token
+    bool fold_constants;       // Pure operators with constant operands are replaced by their value
 };
 
 // Attempts to parse a substring to a double
@@ -59,6 +63,36 @@ bool node_pop(struct ParserState *state, Node **out)
     return true;
 }
 
+/*
+Summary: Replaces operator node by its value if operator is pure and all of its operands are constants
+    When evaluation fails, the node is kept, so that the error is reported when the whole tree is evaluated
+*/
+static Node *fold_constant(Node *op_node)
+{
+    const Operator *op = get_op(op_node);
+    size_t num_args = get_num_children(op_node);
+    if (!op->pure || op->evaluate == NULL) return op_node;
+    for (size_t i = 0; i < num_args; i++)
+    {
+        if (get_type(get_child(op_node, i)) != NTYPE_CONSTANT) return op_node;
+    }
+
+    double inline_args[FOLD_INLINE_ARGS];
+    double *args = num_args <= FOLD_INLINE_ARGS ? inline_args : malloc_wrapper(num_args * sizeof(double));
+    for (size_t i = 0; i < num_args; i++)
+    {
+        args[i] = get_const_value(get_child(op_node, i));
+    }
+    double value;
+    ListenerError err = op->evaluate(num_args, args, &value);
+    if (args != inline_args) free(args);
+    if (err != LISTENERERR_SUCCESS) return op_node;
+
+    Node *res = malloc_constant_node(value, get_token_index(op_node));
+    free_tree(op_node);
+    return res;
+}
+
 bool op_pop_and_insert(struct ParserState *state)
 {
     struct OpData *op_data = (struct OpData*)vec_pop(&state->vec_ops);
@@ -79,15 +113,18 @@ bool op_pop_and_insert(struct ParserState *state)
         for (size_t i = 0; i < get_num_children(op_node); i++)
         {
             // Pop nodes from stack and append them in subtree
-            if (!node_pop(state, get_child_addr(op_node, get_num_children(op_node) - i - 1)))
+            Node *child;
+            if (!node_pop(state, &child))
             {
                 state->curr_tok = op_data->token;
                 // Free already appended children and new node on error
                 free_tree(op_node);
                 return false;
             }
+            set_child(op_node, get_num_children(op_node) - i - 1, child);
         }
-        
+
+        if (state->fold_constants) op_node = fold_constant(op_node);
         node_push(state, op_node);
     }
 
@@ -141,18 +178,29 @@ bool push_opening_parenthesis(struct ParserState *state)
     return op_push(state, (struct OpData){ NULL, OP_DYNAMIC_ARITY, state->curr_tok });
 }
 
-// out_res can be NULL if you only want to check if an error occurred
-ParserError parse_tokens(const ParsingContext *ctx, size_t num_tokens, const char **tokens, Node **out_res, size_t *error_token)
+/*
+Summary: Shunting-yard algorithm. out_res can be NULL if you only want to check if an error occurred
+Params
+    fold_constants: When true, subtrees that consist of pure operators and constants never materialize.
+        Their value is inserted instead, e.g. pi becomes a number.
+*/
+ParserError parse_tokens(const ParsingContext *ctx,
+    size_t num_tokens,
+    const char **tokens,
+    bool fold_constants,
+    Node **out_res,
+    size_t *error_token)
 {
     // 1. Early outs
     if (ctx == NULL || tokens == NULL) return PERR_ARGS_MALFORMED;
 
     // 2. Initialize state
     struct ParserState state = {
-        .ctx       = ctx,
-        .result    = PERR_SUCCESS,
-        .vec_nodes = vec_create(sizeof(Node*), VECTOR_STARTSIZE),
-        .vec_ops   = vec_create(sizeof(struct OpData), VECTOR_STARTSIZE)
+        .ctx            = ctx,
+        .result         = PERR_SUCCESS,
+        .vec_nodes      = vec_create(sizeof(Node*), VECTOR_STARTSIZE),
+        .vec_ops        = vec_create(sizeof(struct OpData), VECTOR_STARTSIZE),
+        .fold_constants = fold_constants
     };
 
     // 3. Process each token
@@ -448,7 +496,28 @@ Returns: True if success, False otherwise
 bool parse_input(const ParsingContext *ctx, const char *input, ParsingResult *out_res)
 {
     out_res->tokens = tokenize(input, &ctx->keywords_trie);
-    out_res->error = parse_tokens(ctx, vec_count(&out_res->tokens), out_res->tokens.buffer, &out_res->tree, &out_res->error_token);
+    out_res->error = parse_tokens(ctx,
+        vec_count(&out_res->tokens),
+        out_res->tokens.buffer,
+        false,
+        &out_res->tree,
+        &out_res->error_token);
+    return out_res->error == PERR_SUCCESS;
+}
+
+/*
+Summary: Like parse_input, but constant subtrees of pure operators are evaluated while parsing.
+    Use it when the tree is evaluated or simplified anyway.
+*/
+bool parse_input_folded(const ParsingContext *ctx, const char *input, ParsingResult *out_res)
+{
+    out_res->tokens = tokenize(input, &ctx->keywords_trie);
+    out_res->error = parse_tokens(ctx,
+        vec_count(&out_res->tokens),
+        out_res->tokens.buffer,
+        true,
+        &out_res->tree,
+        &out_res->error_token);
     return out_res->error == PERR_SUCCESS;
 }
 
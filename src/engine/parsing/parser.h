@@ -25,7 +25,13 @@ typedef struct {
     Node *tree;
 } ParsingResult;
 
-ParserError parse_tokens(const ParsingContext *ctx, size_t num_tokens, const char **tokens, Node **out_res, size_t *error_token);
+ParserError parse_tokens(const ParsingContext *ctx,
+    size_t num_tokens,
+    const char **tokens,
+    bool fold_constants,
+    Node **out_res,
+    size_t *error_token);
 bool parse_input(const ParsingContext *ctx, const char *input, ParsingResult *out_res);
+bool parse_input_folded(const ParsingContext *ctx, const char *input, ParsingResult *out_res);
 Node *parse_easy(const ParsingContext *ctx, const char *input);
 void free_result(ParsingResult *result, bool also_free_tree);
@@ -0,0 +1,483 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "../../util/alloc_wrappers.h"
+#include "../tree/tree_util.h"
+#include "egraph.h"
+#include "rewrite_rule.h"
+#include "transformation.h"
+
+#define VECTOR_STARTSIZE 16
+#define NO_ENODE         SIZE_MAX
+#define INFINITE_COST    SIZE_MAX
+
+/*
+An e-graph represents a set of equivalent terms compactly. Each e-class is a set of e-nodes, each e-node is an
+operator whose children are e-classes or a leaf. Since terms are hash-consed, every subterm is stored only once.
+E-classes are identified by the index of the e-node that created them and are merged with a union-find forest.
+*/
+
+typedef struct
+{
+    const Operator *op;  // NULL for leafs
+    Node *leaf;          // Copy of constant or variable node, NULL for operators
+    size_t num_children;
+    size_t first_child;  // Index of class of first child in EGraph.children
+    size_t token_index;  // To preserve error information
+    bool duplicate;      // Congruent to another e-node, can be skipped
+} ENode;
+
+typedef struct
+{
+    Vector enodes;     // ENode
+    Vector children;   // size_t, class ids of children of e-nodes
+    Vector uf;         // size_t, union-find forest of class ids
+    Vector costs;      // size_t, cost of cheapest term of class
+    Vector best;       // size_t, e-node of cheapest term of class
+    size_t *table;     // Hash-cons with open addressing, contains e-node indices
+    size_t table_size; // Power of two
+    size_t table_count;
+    size_t num_unions; // Counts successful unions to detect changes
+} EGraph;
+
+// Rule instance found during search, applied afterwards
+typedef struct
+{
+    size_t eclass;
+    Node *term;
+} PendingUnion;
+
+static ENode *get_enode(const EGraph *g, size_t index)
+{
+    return (ENode*)vec_get(&g->enodes, index);
+}
+
+static size_t *get_children(const EGraph *g, const ENode *enode)
+{
+    return (size_t*)vec_get(&g->children, enode->first_child);
+}
+
+static size_t find(EGraph *g, size_t id)
+{
+    size_t *uf = (size_t*)g->uf.buffer;
+    while (uf[id] != id)
+    {
+        uf[id] = uf[uf[id]]; // Path halving
+        id = uf[id];
+    }
+    return id;
+}
+
+// Children of e-node must be canonical
+static size_t hash_enode(const EGraph *g, const ENode *enode)
+{
+    if (enode->op == NULL) return get_hash(enode->leaf);
+
+    size_t res = enode->op->id * 31 + enode->num_children;
+    size_t *children = get_children(g, enode);
+    for (size_t i = 0; i < enode->num_children; i++)
+    {
+        res = (res ^ children[i]) * 16777619u + 0x9e3779b9;
+    }
+    return res;
+}
+
+static bool enodes_equal(const EGraph *g, const ENode *a, const ENode *b)
+{
+    if (a->op == NULL || b->op == NULL)
+    {
+        return a->op == b->op && tree_equals(a->leaf, b->leaf);
+    }
+    if (a->op->id != b->op->id || a->num_children != b->num_children) return false;
+    return memcmp(get_children(g, a), get_children(g, b), a->num_children * sizeof(size_t)) == 0;
+}
+
+static size_t table_lookup(const EGraph *g, const ENode *enode)
+{
+    size_t slot = hash_enode(g, enode) & (g->table_size - 1);
+    while (g->table[slot] != NO_ENODE)
+    {
+        if (enodes_equal(g, get_enode(g, g->table[slot]), enode)) return g->table[slot];
+        slot = (slot + 1) & (g->table_size - 1);
+    }
+    return NO_ENODE;
+}
+
+static void table_reset(EGraph *g, size_t min_size)
+{
+    g->table_size = VECTOR_STARTSIZE;
+    while (g->table_size < 2 * min_size) g->table_size *= 2;
+    g->table = realloc_wrapper(g->table, g->table_size * sizeof(size_t));
+    for (size_t i = 0; i < g->table_size; i++) g->table[i] = NO_ENODE;
+    g->table_count = 0;
+}
+
+static void table_insert(EGraph *g, size_t index)
+{
+    // Keep load factor below 0.5
+    if (2 * (g->table_count + 1) > g->table_size)
+    {
+        size_t *old_table = g->table;
+        size_t old_size = g->table_size;
+        g->table = NULL;
+        table_reset(g, g->table_count + 1);
+        for (size_t i = 0; i < old_size; i++)
+        {
+            if (old_table[i] != NO_ENODE) table_insert(g, old_table[i]);
+        }
+        free(old_table);
+    }
+
+    size_t slot = hash_enode(g, get_enode(g, index)) & (g->table_size - 1);
+    while (g->table[slot] != NO_ENODE) slot = (slot + 1) & (g->table_size - 1);
+    g->table[slot] = index;
+    g->table_count++;
+}
+
+static EGraph egraph_create()
+{
+    EGraph res = {
+        .enodes     = vec_create(sizeof(ENode), VECTOR_STARTSIZE),
+        .children   = vec_create(sizeof(size_t), VECTOR_STARTSIZE),
+        .uf         = vec_create(sizeof(size_t), VECTOR_STARTSIZE),
+        .costs      = vec_create(sizeof(size_t), VECTOR_STARTSIZE),
+        .best       = vec_create(sizeof(size_t), VECTOR_STARTSIZE),
+        .table      = NULL,
+        .num_unions = 0
+    };
+    table_reset(&res, 0);
+    return res;
+}
+
+static void egraph_destroy(EGraph *g)
+{
+    for (size_t i = 0; i < vec_count(&g->enodes); i++)
+    {
+        free_tree(get_enode(g, i)->leaf);
+    }
+    vec_destroy(&g->enodes);
+    vec_destroy(&g->children);
+    vec_destroy(&g->uf);
+    vec_destroy(&g->costs);
+    vec_destroy(&g->best);
+    free(g->table);
+}
+
+/*
+Summary: Adds e-node if no congruent e-node is present
+Returns: Class of new or congruent e-node
+Params
+    leaf: Is copied when e-node is added
+*/
+static size_t add_enode(EGraph *g,
+    const Operator *op,
+    const Node *leaf,
+    size_t num_children,
+    const size_t *children,
+    size_t token_index)
+{
+    ENode candidate = {
+        .op           = op,
+        .leaf         = (Node*)leaf,
+        .num_children = num_children,
+        .first_child  = vec_count(&g->children),
+        .token_index  = token_index,
+        .duplicate    = false
+    };
+    for (size_t i = 0; i < num_children; i++)
+    {
+        VEC_PUSH_ELEM(&g->children, size_t, find(g, children[i]));
+    }
+
+    size_t existing = table_lookup(g, &candidate);
+    if (existing != NO_ENODE)
+    {
+        g->children.elem_count = candidate.first_child;
+        return find(g, existing);
+    }
+
+    size_t index = vec_count(&g->enodes);
+    if (leaf != NULL) candidate.leaf = tree_copy(leaf);
+    VEC_PUSH_ELEM(&g->enodes, ENode, candidate);
+    VEC_PUSH_ELEM(&g->uf, size_t, index);
+    VEC_PUSH_ELEM(&g->costs, size_t, INFINITE_COST);
+    VEC_PUSH_ELEM(&g->best, size_t, index);
+    table_insert(g, index);
+    return index;
+}
+
+static size_t add_term(EGraph *g, const Node *tree)
+{
+    if (get_type(tree) != NTYPE_OPERATOR)
+    {
+        return add_enode(g, NULL, tree, 0, NULL, get_token_index(tree));
+    }
+
+    size_t num_children = get_num_children(tree);
+    size_t *children = malloc_wrapper(num_children * sizeof(size_t));
+    for (size_t i = 0; i < num_children; i++)
+    {
+        children[i] = add_term(g, get_child(tree, i));
+    }
+    size_t res = add_enode(g, get_op(tree), NULL, num_children, children, get_token_index(tree));
+    free(children);
+    return res;
+}
+
+// Returns: True if classes were distinct
+static bool merge(EGraph *g, size_t a, size_t b)
+{
+    a = find(g, a);
+    b = find(g, b);
+    if (a == b) return false;
+
+    // Older class stays root
+    if (b < a)
+    {
+        size_t temp = a;
+        a = b;
+        b = temp;
+    }
+    ((size_t*)g->uf.buffer)[b] = a;
+    g->num_unions++;
+    return true;
+}
+
+/*
+Summary: Restores congruence closure: e-nodes with equal operator and equivalent children are merged
+*/
+static void rebuild(EGraph *g)
+{
+    size_t unions_before;
+    do
+    {
+        unions_before = g->num_unions;
+        table_reset(g, vec_count(&g->enodes));
+        for (size_t i = 0; i < vec_count(&g->enodes); i++)
+        {
+            ENode *enode = get_enode(g, i);
+            size_t *children = get_children(g, enode);
+            for (size_t j = 0; j < enode->num_children; j++)
+            {
+                children[j] = find(g, children[j]);
+            }
+
+            size_t existing = table_lookup(g, enode);
+            if (existing == NO_ENODE)
+            {
+                enode->duplicate = false;
+                table_insert(g, i);
+            }
+            else
+            {
+                enode->duplicate = true;
+                merge(g, existing, i);
+            }
+        }
+    } while (g->num_unions != unions_before);
+}
+
+/*
+Summary: Adds constant to each class that contains an operator whose children are constant
+*/
+static void fold_constants(EGraph *g, TreeListener folder)
+{
+    if (folder == NULL) return;
+
+    size_t num_enodes = vec_count(&g->enodes);
+    bool *is_const = calloc_wrapper(num_enodes, sizeof(bool));
+    double *values = malloc_wrapper(num_enodes * sizeof(double));
+    for (size_t i = 0; i < num_enodes; i++)
+    {
+        ENode *enode = get_enode(g, i);
+        if (enode->op == NULL && get_type(enode->leaf) == NTYPE_CONSTANT)
+        {
+            is_const[find(g, i)] = true;
+            values[find(g, i)] = get_const_value(enode->leaf);
+        }
+    }
+
+    for (size_t i = 0; i < num_enodes; i++)
+    {
+        ENode *enode = get_enode(g, i);
+        if (enode->op == NULL || enode->duplicate || is_const[find(g, i)]) continue;
+
+        double *args = malloc_wrapper(enode->num_children * sizeof(double));
+        bool foldable = true;
+        for (size_t j = 0; j < enode->num_children; j++)
+        {
+            size_t child = find(g, get_children(g, enode)[j]);
+            if (!is_const[child])
+            {
+                foldable = false;
+                break;
+            }
+            args[j] = values[child];
+        }
+
+        double res;
+        if (foldable && folder(enode->op, enode->num_children, args, &res) == LISTENERERR_SUCCESS)
+        {
+            Node *constant = malloc_constant_node(res, enode->token_index);
+            size_t eclass = find(g, i);
+            merge(g, eclass, add_enode(g, NULL, constant, 0, NULL, enode->token_index));
+            free_tree(constant);
+            is_const[eclass] = true;
+            values[eclass] = res;
+        }
+        free(args);
+    }
+
+    free(is_const);
+    free(values);
+}
+
+/*
+Summary: Computes cost of cheapest term of each class. Cost of a term is its number of nodes.
+*/
+static void compute_costs(EGraph *g)
+{
+    size_t *costs = (size_t*)g->costs.buffer;
+    size_t *best = (size_t*)g->best.buffer;
+    for (size_t i = 0; i < vec_count(&g->costs); i++) costs[i] = INFINITE_COST;
+
+    // Iterate until fixpoint since classes can be cyclic
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 0; i < vec_count(&g->enodes); i++)
+        {
+            ENode *enode = get_enode(g, i);
+            if (enode->duplicate) continue;
+
+            size_t cost = 1;
+            for (size_t j = 0; j < enode->num_children && cost != INFINITE_COST; j++)
+            {
+                size_t child_cost = costs[find(g, get_children(g, enode)[j])];
+                cost = child_cost == INFINITE_COST ? INFINITE_COST : cost + child_cost;
+            }
+            if (cost == INFINITE_COST) continue;
+
+            // Later e-nodes win ties since rules usually rewrite towards the preferred form
+            size_t eclass = find(g, i);
+            if (cost < costs[eclass] || (cost == costs[eclass] && i > best[eclass]))
+            {
+                costs[eclass] = cost;
+                best[eclass] = i;
+                changed = true;
+            }
+        }
+    }
+}
+
+static Node *materialize(EGraph *g, size_t index);
+
+// Returns: Cheapest term of class, compute_costs needs to be called beforehand
+static Node *extract(EGraph *g, size_t eclass)
+{
+    return materialize(g, ((size_t*)g->best.buffer)[find(g, eclass)]);
+}
+
+// Returns: Term with e-node as root and cheapest terms of child classes as children
+static Node *materialize(EGraph *g, size_t index)
+{
+    ENode *enode = get_enode(g, index);
+    if (enode->op == NULL) return tree_copy(enode->leaf);
+
+    Node *res = malloc_operator_node(enode->op, enode->num_children, enode->token_index);
+    for (size_t i = 0; i < enode->num_children; i++)
+    {
+        set_child(res, i, extract(g, get_children(g, enode)[i]));
+    }
+    return res;
+}
+
+// Matches rules against e-node. Rule instances are added to pending.
+static void search_enode(EGraph *g, size_t index, const Vector *ruleset, ConstraintChecker checker, Vector *pending)
+{
+    // Subterms are represented by their cheapest terms, thus not every possible matching is found
+    Node *term = materialize(g, index);
+    for (size_t i = 0; i < vec_count(ruleset); i++)
+    {
+        RewriteRule *rule = (RewriteRule*)vec_get(ruleset, i);
+        Matching *matchings;
+        ProfilerSample sample = profiler_begin();
+        size_t num_matchings = get_all_matchings((const Node**)&term, &rule->pattern, checker, &matchings);
+        profiler_end(rule->stats, sample, num_matchings > 0);
+        for (size_t j = 0; j < num_matchings; j++)
+        {
+            Node *instance = tree_copy(rule->after);
+            set_tok_index_for_all(instance, get_token_index(term));
+            transform_by_matching(&matchings[j], &instance);
+            VEC_PUSH_ELEM(pending, PendingUnion, ((PendingUnion){ .eclass = index, .term = instance }));
+        }
+        free(matchings);
+    }
+    free_tree(term);
+}
+
+/*
+Summary: Equality saturation. Every rule is matched against every e-node and its instances are added to the e-graph
+    until it does not change anymore or a limit is hit. Then, the smallest equivalent term replaces tree.
+    Search stops early when the pending instances would exceed max_enodes or the deadline has passed.
+    In contrast to apply_ruleset, rules are not priorized by order and no ordering is needed to avoid loops.
+Returns: Number of rule instances that added an equivalence
+Params
+    folder: Used to add a constant to every class containing an operator with constant children. Can be NULL
+*/
+size_t apply_ruleset_saturating(Node **tree,
+    const Vector *ruleset,
+    ConstraintChecker checker,
+    TreeListener folder,
+    SaturationLimits limits)
+{
+    RewriteBudget deadline = { .max_steps = SIZE_MAX, .deadline = limits.deadline };
+    EGraph g = egraph_create();
+    Vector pending = vec_create(sizeof(PendingUnion), VECTOR_STARTSIZE);
+    size_t root = add_term(&g, *tree);
+    fold_constants(&g, folder);
+    rebuild(&g);
+
+    size_t counter = 0;
+    for (size_t iteration = 0; iteration < limits.max_iterations; iteration++)
+    {
+        size_t num_enodes = vec_count(&g.enodes);
+        size_t num_unions = g.num_unions;
+
+        // 1. Search rule instances in current e-graph, as long as they could still be added
+        compute_costs(&g);
+        for (size_t i = 0; i < num_enodes; i++)
+        {
+            if (num_enodes + vec_count(&pending) >= limits.max_enodes || budget_exhausted(&deadline, 0)) break;
+            if (!get_enode(&g, i)->duplicate)
+            {
+                search_enode(&g, i, ruleset, checker, &pending);
+            }
+        }
+
+        // 2. Add instances and merge them with class they were found in
+        for (size_t i = 0; i < vec_count(&pending); i++)
+        {
+            PendingUnion *curr = (PendingUnion*)vec_get(&pending, i);
+            if (vec_count(&g.enodes) < limits.max_enodes && merge(&g, curr->eclass, add_term(&g, curr->term)))
+            {
+                counter++;
+            }
+            free_tree(curr->term);
+        }
+        vec_clear(&pending);
+        fold_constants(&g, folder);
+        rebuild(&g);
+
+        // Saturated or limit hit
+        if (vec_count(&g.enodes) == num_enodes && g.num_unions == num_unions) break;
+        if (vec_count(&g.enodes) >= limits.max_enodes || budget_exhausted(&deadline, 0)) break;
+    }
+
+    compute_costs(&g);
+    tree_replace(tree, extract(&g, root));
+    vec_destroy(&pending);
+    egraph_destroy(&g);
+    return counter;
+}
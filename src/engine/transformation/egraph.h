@@ -0,0 +1,25 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../../util/vector.h"
+#include "../tree/node.h"
+#include "../tree/tree_util.h"
+#include "matching.h"
+
+/*
+Equality saturation: Rules of a ruleset are not applied destructively but add equivalent terms to an e-graph
+until no new term emerges or a limit is reached. Afterwards, the smallest equivalent term is extracted.
+*/
+
+typedef struct
+{
+    size_t max_enodes;     // Saturation stops when e-graph consists of more e-nodes
+    size_t max_iterations; // Maximum number of times all rules are tried on whole e-graph
+    double deadline;       // Monotonic time in seconds after which saturation stops, INFINITY if none
+} SaturationLimits;
+
+size_t apply_ruleset_saturating(Node **tree,
+    const Vector *ruleset,
+    ConstraintChecker checker,
+    TreeListener folder,
+    SaturationLimits limits);
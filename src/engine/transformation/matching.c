@@ -8,16 +8,14 @@
 #include "../tree/tree_util.h"
 #include "../tree/tree_to_string.h"
 #include "../../util/vector.h"
+#include "../../util/alloc_wrappers.h"
 #include "../../util/console_util.h"
 #include "../../util/string_util.h"
 
 #define VECTOR_STARTSIZE 1
 
-// On stack during matching
-typedef struct {
-    const Pattern *pattern;
-    ConstraintChecker checker;
-} MatchingContext;
+// Total number of partial matchings constructed, used by profiler. Updated atomically since matching is thread-safe
+static size_t num_partial_matchings = 0;
 
 // A suffix-tree is used to lookup common prefixes of matchings
 typedef struct {
@@ -29,6 +27,135 @@ typedef struct {
     size_t parent_index;      // Index of parent node within suffix-vector
 } SuffixNode;
 
+// Buffers of one recursion level of match_parameter_lists, reused by every call on this level
+typedef struct {
+    Vector local_matchings; // Matching
+    Vector suffixes;        // SuffixNode
+    Vector end_indices;     // size_t, suffix nodes that map all pattern children to all tree children
+} ScratchLevel;
+
+/*
+Unfilled suffix-tree of a parameter list of a pattern and a number of tree children.
+It only depends on them as long as no list-variable of the parameter list is bound,
+thus it can be reused when the pattern is tried at another node of the same arity.
+*/
+typedef struct {
+    const Node **pattern_children;
+    size_t num_tree_children;
+    Vector suffixes;    // SuffixNode
+    Vector end_indices; // size_t
+} SuffixSkeleton;
+
+// On stack during matching
+typedef struct {
+    const Pattern *pattern;
+    ConstraintChecker checker;
+    size_t num_partial_matchings;
+    size_t depth;      // Recursion depth of match_parameter_lists
+    Vector scratch;    // ScratchLevel*, one for each recursion depth
+    Vector skeletons;  // SuffixSkeleton
+    size_t num_overflow;    // Number of variables of pattern that do not fit into Matching.inline_nodes
+    Vector overflow_blocks; // NodeList*, overflow arrays of partial matchings, freed with context
+} MatchingContext;
+
+static MatchingContext create_context(const Pattern *pattern, ConstraintChecker checker)
+{
+    return (MatchingContext){
+        .pattern               = pattern,
+        .checker               = checker,
+        .num_partial_matchings = 0,
+        .depth                 = 0,
+        .scratch               = vec_create(sizeof(ScratchLevel*), VECTOR_STARTSIZE),
+        .skeletons             = vec_create(sizeof(SuffixSkeleton), VECTOR_STARTSIZE),
+        .num_overflow          = pattern->num_vars > MATCHING_INLINE_VARS
+                                     ? pattern->num_vars - MATCHING_INLINE_VARS : 0,
+        .overflow_blocks       = vec_create(sizeof(NodeList*), VECTOR_STARTSIZE)
+    };
+}
+
+static void destroy_context(MatchingContext *ctx)
+{
+    for (size_t i = 0; i < vec_count(&ctx->scratch); i++)
+    {
+        ScratchLevel *level = *(ScratchLevel**)vec_get(&ctx->scratch, i);
+        vec_destroy(&level->local_matchings);
+        vec_destroy(&level->suffixes);
+        vec_destroy(&level->end_indices);
+        free(level);
+    }
+    for (size_t i = 0; i < vec_count(&ctx->skeletons); i++)
+    {
+        SuffixSkeleton *skeleton = (SuffixSkeleton*)vec_get(&ctx->skeletons, i);
+        vec_destroy(&skeleton->suffixes);
+        vec_destroy(&skeleton->end_indices);
+    }
+    for (size_t i = 0; i < vec_count(&ctx->overflow_blocks); i++)
+    {
+        free(*(NodeList**)vec_get(&ctx->overflow_blocks, i));
+    }
+    vec_destroy(&ctx->scratch);
+    vec_destroy(&ctx->skeletons);
+    vec_destroy(&ctx->overflow_blocks);
+    __atomic_fetch_add(&num_partial_matchings, ctx->num_partial_matchings, __ATOMIC_RELAXED);
+}
+
+/*
+Summary: Partial matchings are copied by value and share their overflow array, thus it is copied before a binding
+    is written to it. Copies live as long as the context.
+Params
+    overflow: Is allowed to be NULL, an unbound overflow array is returned in this case
+*/
+static NodeList *clone_overflow(MatchingContext *ctx, const NodeList *overflow)
+{
+    NodeList *res = malloc_wrapper(ctx->num_overflow * sizeof(NodeList));
+    if (overflow != NULL)
+    {
+        memcpy(res, overflow, ctx->num_overflow * sizeof(NodeList));
+    }
+    else
+    {
+        for (size_t i = 0; i < ctx->num_overflow; i++)
+        {
+            res[i] = (NodeList){ .size = 0, .nodes = NULL };
+        }
+    }
+    VEC_PUSH_ELEM(&ctx->overflow_blocks, NodeList*, res);
+    return res;
+}
+
+// Returns: Copy of matching with an overflow array of its own on heap, free it with free_matching
+static Matching detach_matching(const MatchingContext *ctx, const Matching *matching)
+{
+    Matching res = *matching;
+    if (ctx->num_overflow > 0)
+    {
+        res.overflow = malloc_wrapper(ctx->num_overflow * sizeof(NodeList));
+        memcpy(res.overflow, matching->overflow, ctx->num_overflow * sizeof(NodeList));
+    }
+    return res;
+}
+
+// Returns: Cleared buffers of current recursion depth, heap-allocated so that they survive growth of ctx->scratch
+static ScratchLevel *get_scratch_level(MatchingContext *ctx)
+{
+    if (ctx->depth == vec_count(&ctx->scratch))
+    {
+        ScratchLevel *level = malloc_wrapper(sizeof(ScratchLevel));
+        *level = (ScratchLevel){
+            .local_matchings = vec_create(sizeof(Matching), VECTOR_STARTSIZE),
+            .suffixes        = vec_create(sizeof(SuffixNode), VECTOR_STARTSIZE),
+            .end_indices     = vec_create(sizeof(size_t), VECTOR_STARTSIZE)
+        };
+        VEC_PUSH_ELEM(&ctx->scratch, ScratchLevel*, level);
+    }
+
+    ScratchLevel *level = *(ScratchLevel**)vec_get(&ctx->scratch, ctx->depth);
+    vec_clear(&level->local_matchings);
+    vec_clear(&level->suffixes);
+    vec_clear(&level->end_indices);
+    return level;
+}
+
 static void extend_matching(MatchingContext *ctx,
     Matching matching,
     const Node *pattern,
@@ -72,20 +199,18 @@ static void fill_suffix(
     curr->num_matchings = vec_count(matchings) - curr->first_match_index;
 }
 
-static void match_parameter_lists(
-    MatchingContext *ctx,
-    Matching matching,
+/*
+Summary: Creates suffix-tree that contains every partition of tree children among pattern children
+*/
+static void build_suffixes(
+    const Matching *matching,
     size_t num_pattern_children,
     const Node **pattern_children,
     size_t num_tree_children,
-    const Node **tree_children,
-    Vector *out_matchings)
+    Vector *suffixes,
+    Vector *end_indices)
 {
-    Vector vec_local_matchings = vec_create(sizeof(Matching), VECTOR_STARTSIZE);
-    Vector vec_suffixes = vec_create(sizeof(SuffixNode), VECTOR_STARTSIZE);
-
-    vec_push(&vec_local_matchings, &matching);
-    VEC_PUSH_ELEM(&vec_suffixes, SuffixNode, ((SuffixNode){
+    VEC_PUSH_ELEM(suffixes, SuffixNode, ((SuffixNode){
         .first_match_index = 0,
         .num_matchings     = 1,
         .sum               = 0,
@@ -95,29 +220,16 @@ static void match_parameter_lists(
     }));
 
     size_t curr_index = 0;
-    while (curr_index < vec_count(&vec_suffixes))
+    while (curr_index < vec_count(suffixes))
     {
-        // Since vec_suffixes's buffer could be realloced by any insertion, we can't store a pointer to it
-        SuffixNode curr = *(SuffixNode*)vec_get(&vec_suffixes, curr_index);
+        // Since suffixes's buffer could be realloced by any insertion, we can't store a pointer to it
+        SuffixNode curr = *(SuffixNode*)vec_get(suffixes, curr_index);
         size_t new_sum = curr.sum + curr.label;
 
-        // We found a valid end node of suffixes. Try to match.
+        // We found a valid end node of suffixes, it is filled later
         if (new_sum == num_tree_children && curr.distance == num_pattern_children)
         {
-            fill_suffix(ctx,
-                curr_index,
-                pattern_children,
-                tree_children,
-                &vec_local_matchings,
-                &vec_suffixes);
-
-            // Update curr
-            curr = *(SuffixNode*)vec_get(&vec_suffixes, curr_index);
-
-            // Copy matchings to result-buffer
-            vec_push_many(out_matchings,
-                vec_count(&vec_local_matchings) - curr.first_match_index,
-                vec_get(&vec_local_matchings, curr.first_match_index));
+            VEC_PUSH_ELEM(end_indices, size_t, curr_index);
         }
 
         // Extend entry of suffixes
@@ -127,11 +239,11 @@ static void match_parameter_lists(
                 && get_var_name(pattern_children[curr.distance])[0] == MATCHING_LIST_PREFIX)
             {
                 // Current pattern-child is list-variable
-                NodeList *list = &matching.mapped_nodes[get_id(pattern_children[curr.distance])];
+                const NodeList *list = get_mapped_nodes(matching, get_id(pattern_children[curr.distance]));
                 if (list->nodes != NULL && new_sum + 1 <= num_tree_children)
                 {
                     // List is already bound, thus also its length is bound
-                    VEC_PUSH_ELEM(&vec_suffixes, SuffixNode, ((SuffixNode){
+                    VEC_PUSH_ELEM(suffixes, SuffixNode, ((SuffixNode){
                         .first_match_index = SIZE_MAX,
                         .num_matchings     = 0,
                         .label             = list->size,
@@ -146,7 +258,7 @@ static void match_parameter_lists(
                     {
                         // Special case: List is last pattern-child
                         // We can avoid extending suffixes with lists that are too short
-                        VEC_PUSH_ELEM(&vec_suffixes, SuffixNode, ((SuffixNode){
+                        VEC_PUSH_ELEM(suffixes, SuffixNode, ((SuffixNode){
                                 .first_match_index = SIZE_MAX,
                                 .num_matchings     = 0,
                                 .label             = num_tree_children - new_sum,
@@ -161,7 +273,7 @@ static void match_parameter_lists(
                         size_t num_insertions = num_tree_children - new_sum + 1;
                         for (size_t i = 0; i < num_insertions; i++)
                         {
-                            VEC_PUSH_ELEM(&vec_suffixes, SuffixNode, ((SuffixNode){
+                            VEC_PUSH_ELEM(suffixes, SuffixNode, ((SuffixNode){
                                 .first_match_index = SIZE_MAX,
                                 .num_matchings     = 0,
                                 .label             = i,
@@ -178,7 +290,7 @@ static void match_parameter_lists(
                 if (new_sum < num_tree_children)
                 {
                     // Any non-list node in pattern corresponds to exactly one node in tree
-                    VEC_PUSH_ELEM(&vec_suffixes, SuffixNode, ((SuffixNode){
+                    VEC_PUSH_ELEM(suffixes, SuffixNode, ((SuffixNode){
                         .first_match_index = SIZE_MAX,
                         .num_matchings     = 0,
                         .label             = 1,
@@ -191,9 +303,105 @@ static void match_parameter_lists(
         }
         curr_index++;
     }
-    
-    vec_destroy(&vec_local_matchings);
-    vec_destroy(&vec_suffixes);
+}
+
+static bool contains_bound_list(const Matching *matching, size_t num_pattern_children, const Node **pattern_children)
+{
+    for (size_t i = 0; i < num_pattern_children; i++)
+    {
+        if (get_type(pattern_children[i]) == NTYPE_VARIABLE
+            && get_var_name(pattern_children[i])[0] == MATCHING_LIST_PREFIX
+            && get_mapped_nodes(matching, get_id(pattern_children[i]))->nodes != NULL)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Copies skeleton for pattern children and number of tree children into level, builds it when not present yet
+static void load_skeleton(MatchingContext *ctx,
+    const Matching *matching,
+    size_t num_pattern_children,
+    const Node **pattern_children,
+    size_t num_tree_children,
+    ScratchLevel *level)
+{
+    for (size_t i = 0; i < vec_count(&ctx->skeletons); i++)
+    {
+        SuffixSkeleton *skeleton = (SuffixSkeleton*)vec_get(&ctx->skeletons, i);
+        if (skeleton->pattern_children == pattern_children && skeleton->num_tree_children == num_tree_children)
+        {
+            vec_push_many(&level->suffixes, vec_count(&skeleton->suffixes), skeleton->suffixes.buffer);
+            vec_push_many(&level->end_indices, vec_count(&skeleton->end_indices), skeleton->end_indices.buffer);
+            return;
+        }
+    }
+
+    build_suffixes(matching,
+        num_pattern_children,
+        pattern_children,
+        num_tree_children,
+        &level->suffixes,
+        &level->end_indices);
+
+    SuffixSkeleton skeleton = (SuffixSkeleton){
+        .pattern_children  = pattern_children,
+        .num_tree_children = num_tree_children,
+        .suffixes          = vec_create(sizeof(SuffixNode), vec_count(&level->suffixes)),
+        .end_indices       = vec_create(sizeof(size_t), vec_count(&level->end_indices) + 1)
+    };
+    vec_push_many(&skeleton.suffixes, vec_count(&level->suffixes), level->suffixes.buffer);
+    vec_push_many(&skeleton.end_indices, vec_count(&level->end_indices), level->end_indices.buffer);
+    VEC_PUSH_ELEM(&ctx->skeletons, SuffixSkeleton, skeleton);
+}
+
+static void match_parameter_lists(
+    MatchingContext *ctx,
+    Matching matching,
+    size_t num_pattern_children,
+    const Node **pattern_children,
+    size_t num_tree_children,
+    const Node **tree_children,
+    Vector *out_matchings)
+{
+    ScratchLevel *level = get_scratch_level(ctx);
+    ctx->depth++;
+
+    vec_push(&level->local_matchings, &matching);
+    if (contains_bound_list(&matching, num_pattern_children, pattern_children))
+    {
+        // Lengths of bound lists are fixed, suffix-tree is special to this matching
+        build_suffixes(&matching,
+            num_pattern_children,
+            pattern_children,
+            num_tree_children,
+            &level->suffixes,
+            &level->end_indices);
+    }
+    else
+    {
+        load_skeleton(ctx, &matching, num_pattern_children, pattern_children, num_tree_children, level);
+    }
+
+    for (size_t i = 0; i < vec_count(&level->end_indices); i++)
+    {
+        size_t end_index = *(size_t*)vec_get(&level->end_indices, i);
+        fill_suffix(ctx,
+            end_index,
+            pattern_children,
+            tree_children,
+            &level->local_matchings,
+            &level->suffixes);
+
+        // Copy matchings to result-buffer
+        SuffixNode *end = (SuffixNode*)vec_get(&level->suffixes, end_index);
+        vec_push_many(out_matchings,
+            vec_count(&level->local_matchings) - end->first_match_index,
+            vec_get(&level->local_matchings, end->first_match_index));
+    }
+
+    ctx->depth--;
 }
 
 static bool nodelists_equal(const NodeList *a, const NodeList *b)
@@ -219,30 +427,36 @@ static void extend_matching(
         case NTYPE_VARIABLE:
         {
             size_t id = get_id(pattern);
-            NodeList *nodes = &matching.mapped_nodes[id];
+            NodeList *nodes = get_mapped_nodes(&matching, id);
             if (nodes->nodes != NULL) // Already bound
             {
                 // Is already bound variable equal to this occurrence?
                 if (nodelists_equal(nodes, &tree_list))
                 {
+                    ctx->num_partial_matchings++;
                     vec_push(out_matchings, &matching);
                 }
                 return;
             }
             else
             {
-                matching.mapped_nodes[id] = tree_list;
+                if (id >= MATCHING_INLINE_VARS)
+                {
+                    matching.overflow = clone_overflow(ctx, matching.overflow);
+                }
+                *get_mapped_nodes(&matching, id) = tree_list;
 
                 // Check constraints if its okay to bind
-                for (size_t i = 0; i < ctx->pattern->num_constraints[id]; i++)
+                for (size_t i = ctx->pattern->constraint_offsets[id]; i < ctx->pattern->constraint_offsets[id + 1]; i++)
                 {
-                    Node *constr_cpy = tree_copy(ctx->pattern->constraints[id][i]);
+                    Node *constr_cpy = tree_copy(ctx->pattern->constraints[i]);
                     transform_by_matching(&matching, &constr_cpy);
                     bool res = ctx->checker(&constr_cpy);
                     free_tree(constr_cpy);
                     if (!res) return;
                 }
 
+                ctx->num_partial_matchings++;
                 vec_push(out_matchings, &matching);
                 return;
             }
@@ -253,6 +467,7 @@ static void extend_matching(
         {
             if (tree_list.size == 1 && tree_equals(pattern, tree_list.nodes[0]))
             {
+                ctx->num_partial_matchings++;
                 vec_push(out_matchings, &matching);
             }
             return;
@@ -277,6 +492,20 @@ static void extend_matching(
     }
 }
 
+// Appends all matchings of pattern of context at root of tree to result
+static void match_root(MatchingContext *ctx, const Node **tree, Vector *result)
+{
+    extend_matching(
+        ctx,
+        (Matching){
+            .inline_nodes = { { .size = 0, .nodes = NULL } },
+            .overflow     = ctx->num_overflow > 0 ? clone_overflow(ctx, NULL) : NULL
+        },
+        ctx->pattern->pattern,
+        (NodeList){ .size = 1, .nodes = tree },
+        result);
+}
+
 /*
 Summary: Generates all possible matchings
 Params
@@ -291,21 +520,29 @@ size_t get_all_matchings(const Node **tree, const Pattern *pattern, ConstraintCh
     if (tree == NULL || pattern == NULL) return false;
 
     // Create context object and pass by pointer, this saves stack space during recursion
-    MatchingContext ctx = (MatchingContext){
-        .pattern = pattern,
-        .checker = checker
-    };
+    MatchingContext ctx = create_context(pattern, checker);
     // Due to exponentially many partitions of parameter lists, a lot of partial matchings can occur. Use heap.
     Vector result = vec_create(sizeof(Matching), VECTOR_STARTSIZE);
+    match_root(&ctx, tree, &result);
+    size_t num_matchings = vec_count(&result);
 
-    extend_matching(
-        &ctx,
-        (Matching){ .mapped_nodes = { { .size = 0, .nodes = NULL } } },
-        pattern->pattern,
-        (NodeList){ .size = 1, .nodes = tree },
-        &result);
-    
-    if (out_matchings != NULL)
+    if (out_matchings != NULL && ctx.num_overflow > 0)
+    {
+        // Overflow arrays are placed behind the matchings, so that a single free releases everything
+        size_t matchings_size = num_matchings * sizeof(Matching);
+        size_t overflow_size = ctx.num_overflow * sizeof(NodeList);
+        Matching *packed = malloc_wrapper(matchings_size + num_matchings * overflow_size);
+        NodeList *packed_overflow = (NodeList*)((char*)packed + matchings_size);
+        for (size_t i = 0; i < num_matchings; i++)
+        {
+            packed[i] = *(Matching*)vec_get(&result, i);
+            memcpy(packed_overflow + i * ctx.num_overflow, packed[i].overflow, overflow_size);
+            packed[i].overflow = packed_overflow + i * ctx.num_overflow;
+        }
+        vec_destroy(&result);
+        *out_matchings = packed;
+    }
+    else if (out_matchings != NULL)
     {
         *out_matchings = (Matching*)result.buffer;
     }
@@ -313,8 +550,9 @@ size_t get_all_matchings(const Node **tree, const Pattern *pattern, ConstraintCh
     {
         vec_destroy(&result);
     }
-    
-    return result.elem_count;
+
+    destroy_context(&ctx);
+    return num_matchings;
 }
 
 /*
@@ -328,68 +566,107 @@ bool get_matching(const Node **tree, const Pattern *pattern, ConstraintChecker c
 {
     if (tree == NULL || pattern == NULL) return false;
 
-    Matching *matchings;
-    size_t num_matchings = get_all_matchings(tree, pattern, checker, &matchings);
+    MatchingContext ctx = create_context(pattern, checker);
+    Vector matchings = vec_create(sizeof(Matching), VECTOR_STARTSIZE);
+    match_root(&ctx, tree, &matchings);
 
     // Return first matching if any
-    if (num_matchings > 0)
-    {
-        if (out_matching != NULL)
-        {
-            *out_matching = matchings[0];
-        }
-        free(matchings);
-        return true;
-    }
-    else
+    bool res = vec_count(&matchings) > 0;
+    if (res && out_matching != NULL)
     {
-        free(matchings);
-        return false;
+        *out_matching = detach_matching(&ctx, (Matching*)vec_get(&matchings, 0));
     }
+    vec_destroy(&matchings);
+    destroy_context(&ctx);
+    return res;
 }
 
 /*
 Summary: Looks for matching in tree, i.e. suffixess to construct matching in each node until matching is found (Top-Down)
 */
-Node **find_matching(const Node **tree, const Pattern *pattern, ConstraintChecker checker, Matching *out_matching)
+static Node **find_matching_in_context(MatchingContext *ctx,
+    const Node **tree,
+    Vector *matchings,
+    Matching *out_matching)
 {
-    if (get_matching(tree, pattern, checker, out_matching)) return (Node**)tree;
+    vec_clear(matchings);
+    match_root(ctx, tree, matchings);
+    if (vec_count(matchings) > 0)
+    {
+        if (out_matching != NULL)
+        {
+            *out_matching = detach_matching(ctx, (Matching*)vec_get(matchings, 0));
+        }
+        return (Node**)tree;
+    }
+
     if (get_type(*tree) == NTYPE_OPERATOR)
     {
         for (size_t i = 0; i < get_num_children(*tree); i++)
         {
-            Node **res = find_matching((const Node**)get_child_addr(*tree, i), pattern, checker, out_matching);
+            Node **res = find_matching_in_context(ctx,
+                (const Node**)get_child_addr(*tree, i),
+                matchings,
+                out_matching);
             if (res != NULL) return res;
         }
     }
     return NULL;
 }
 
+Node **find_matching(const Node **tree, const Pattern *pattern, ConstraintChecker checker, Matching *out_matching)
+{
+    if (tree == NULL || pattern == NULL) return NULL;
+
+    // Buffers and suffix-trees are shared among all nodes the pattern is tried at
+    MatchingContext ctx = create_context(pattern, checker);
+    Vector matchings = vec_create(sizeof(Matching), VECTOR_STARTSIZE);
+    Node **res = find_matching_in_context(&ctx, tree, &matchings, out_matching);
+    vec_destroy(&matchings);
+    destroy_context(&ctx);
+    return res;
+}
+
+/*
+Summary: Frees overflow array of a matching returned by get_matching or find_matching.
+    Matchings returned by get_all_matchings are freed with their buffer.
+*/
+void free_matching(Matching *matching)
+{
+    free(matching->overflow);
+}
+
+/*
+Summary: Partial matchings are counted since start of program, only differences are meaningful
+*/
+size_t get_num_partial_matchings()
+{
+    return __atomic_load_n(&num_partial_matchings, __ATOMIC_RELAXED);
+}
+
 /*
 Summary: - Sets ids of variable nodes for faster lookup while matching
          - Computes trigger-indices for constraints
-Returns:  0 if success
-         -1 if MAX_MAPPED_VARS exceeded
-         -2 if MATCHING_MAX_CONSTRAINTS exceeded
+    Takes ownership of tree and constraint trees, constrs itself is copied.
 */
-int get_pattern(Node *tree, size_t num_constraints, Node **constrs, Pattern *out_pattern)
+void get_pattern(Node *tree, size_t num_constraints, Node **constrs, Pattern *out_pattern)
 {
+    // Number of variable nodes bounds number of distinct variables
+    const char **free_vars = malloc_wrapper((count_all_variable_nodes(tree) + 1) * sizeof(char*));
+    size_t num_free_vars = list_variables(tree, count_all_variable_nodes(tree), free_vars, NULL);
+
+    // Constraints that do not contain a variable are associated with the first variable
+    size_t num_triggers = num_free_vars > 0 ? num_free_vars : 1;
     *out_pattern = (Pattern){
-        .pattern         = tree,
-        .num_constraints = { 0 }
+        .pattern            = tree,
+        .num_vars           = num_free_vars,
+        .constraint_offsets = calloc_wrapper(num_triggers + 1, sizeof(size_t)),
+        .constraints        = malloc_wrapper((num_constraints + 1) * sizeof(Node*))
     };
 
-    bool sufficient = false;
-    const char *free_vars[MAX_MAPPED_VARS];
-    size_t num_free_vars = list_variables(tree, MAX_MAPPED_VARS, free_vars, &sufficient);
-
-    if (!sufficient)
-    {
-        return MAX_MAPPED_VARS_EXCEEDED;
-    }
-
     // Step 2: Compute contraints that should be checked when variable with this id is bound
     // This involves computing the variable with the highest id that occurs in the constraint
+    size_t *trigger_ids = malloc_wrapper((num_constraints + 1) * sizeof(size_t));
     for (size_t i = 0; i < num_constraints; i++)
     {
         tree_copy_IDs(constrs[i], num_free_vars, free_vars);
@@ -402,27 +679,35 @@ int get_pattern(Node *tree, size_t num_constraints, Node **constrs, Pattern *out
                 max_id = j;
             }
         }
+        trigger_ids[i] = max_id;
+        out_pattern->constraint_offsets[max_id + 1]++;
+    }
 
-        if ((*out_pattern).num_constraints[max_id] == MATCHING_MAX_CONSTRAINTS)
-        {
-            return MATCHING_MAX_CONSTRAINTS_EXCEEDED;
-        }
-
-        // max_id contains trigger index
-        (*out_pattern).constraints[max_id][(*out_pattern).num_constraints[max_id]] = constrs[i];
-        (*out_pattern).num_constraints[max_id]++;
+    // Counting sort by trigger index, order of constraints with equal trigger index is kept
+    for (size_t i = 0; i < num_triggers; i++)
+    {
+        out_pattern->constraint_offsets[i + 1] += out_pattern->constraint_offsets[i];
+    }
+    size_t *next_slot = malloc_wrapper(num_triggers * sizeof(size_t));
+    memcpy(next_slot, out_pattern->constraint_offsets, num_triggers * sizeof(size_t));
+    for (size_t i = 0; i < num_constraints; i++)
+    {
+        out_pattern->constraints[next_slot[trigger_ids[i]]++] = constrs[i];
     }
-    return 0;
+
+    free(next_slot);
+    free(trigger_ids);
+    free(free_vars);
 }
 
 void free_pattern(Pattern *pattern)
 {
     free_tree(pattern->pattern);
-    for (size_t i = 0; i < MAX_MAPPED_VARS; i++)
+    size_t num_constraints = pattern->constraint_offsets[pattern->num_vars > 0 ? pattern->num_vars : 1];
+    for (size_t i = 0; i < num_constraints; i++)
     {
-        for (size_t j = 0; j < pattern->num_constraints[i]; j++)
-        {
-            free_tree(pattern->constraints[i][j]);
-        }
+        free_tree(pattern->constraints[i]);
     }
+    free(pattern->constraint_offsets);
+    free(pattern->constraints);
 }
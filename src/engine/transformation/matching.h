@@ -2,18 +2,18 @@
 #include "../../util/vector.h"
 #include "../tree/node.h"
 
-#define MAX_MAPPED_VARS          10
-#define MATCHING_MAX_CONSTRAINTS  3 // Maximum number of constraints per trigger index
+#define MATCHING_INLINE_VARS 10 // Variables with smaller ids are stored within Matching itself
 #define MATCHING_LIST_PREFIX '['
 
-#define MAX_MAPPED_VARS_EXCEEDED          -1
-#define MATCHING_MAX_CONSTRAINTS_EXCEEDED -2
-
+/*
+Summary: Preprocessed pattern, metadata is sized to the pattern and allocated once by get_pattern
+*/
 typedef struct
 {
     Node *pattern;
-    size_t num_constraints[MAX_MAPPED_VARS];
-    Node *constraints[MAX_MAPPED_VARS][MATCHING_MAX_CONSTRAINTS];
+    size_t num_vars;            // Number of distinct variables, their ids are 0 to num_vars - 1
+    size_t *constraint_offsets; // Constraints triggered by variable with id i are in [offsets[i], offsets[i + 1])
+    Node **constraints;         // Sorted by trigger index, i.e. highest id of a variable occurring in constraint
 } Pattern;
 
 /*
@@ -21,15 +21,26 @@ Summary: Contains successful matching
 */
 typedef struct
 {
-    NodeList mapped_nodes[MAX_MAPPED_VARS]; // Subtrees in matched_tree that need to replace each mapped_var
+    NodeList inline_nodes[MATCHING_INLINE_VARS]; // Subtrees in matched_tree that need to replace each mapped_var
+    NodeList *overflow;                          // Variables with id >= MATCHING_INLINE_VARS, NULL if there are none
 } Matching;
 
+static inline NodeList *get_mapped_nodes(const Matching *matching, size_t id)
+{
+    return id < MATCHING_INLINE_VARS
+        ? (NodeList*)&matching->inline_nodes[id]
+        : &matching->overflow[id - MATCHING_INLINE_VARS];
+}
+
 typedef bool (*ConstraintChecker)(Node **tree);
 
 NodeList *lookup_mapped_var(const Matching *matching, const char *var);
 size_t get_all_matchings(const Node **tree, const Pattern *pattern, ConstraintChecker checker, Matching **out_matchings);
 bool get_matching(const Node **tree, const Pattern *pattern, ConstraintChecker checker, Matching *out_matching);
 Node **find_matching(const Node **tree, const Pattern *pattern, ConstraintChecker checker, Matching *out_matching);
+void free_matching(Matching *matching);
+
+size_t get_num_partial_matchings();
 
-int get_pattern(Node *tree, size_t num_constraints, Node **constrs, Pattern *out_pattern);
+void get_pattern(Node *tree, size_t num_constraints, Node **constrs, Pattern *out_pattern);
 void free_pattern(Pattern *pattern);
@@ -0,0 +1,88 @@
+#include "../../util/alloc_wrappers.h"
+#include "../tree/tree_util.h"
+#include "normal_form_cache.h"
+
+NormalFormCache nfcache_create(size_t num_slots)
+{
+    NormalFormCache res = (NormalFormCache){
+        .num_slots = num_slots,
+        .slots     = calloc_wrapper(num_slots, sizeof(NormalFormEntry))
+    };
+    pthread_mutex_init(&res.lock, NULL);
+    return res;
+}
+
+static void free_entry(NormalFormEntry *entry)
+{
+    free_tree(entry->before);
+    free_tree(entry->after);
+    *entry = (NormalFormEntry){ .ruleset = NULL };
+}
+
+void nfcache_destroy(NormalFormCache *cache)
+{
+    nfcache_clear(cache);
+    free(cache->slots);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+/*
+Summary: Removes all entries, e.g. when rulesets are replaced
+*/
+void nfcache_clear(NormalFormCache *cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    for (size_t i = 0; i < cache->num_slots; i++)
+    {
+        if (cache->slots[i].ruleset != NULL) free_entry(&cache->slots[i]);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+Params
+    out_normal_form: Contains copy of normal form of tree when found
+Returns: True if normal form of tree with respect to ruleset is cached
+*/
+bool nfcache_lookup(NormalFormCache *cache, const void *ruleset, const Node *tree, Node **out_normal_form)
+{
+    if (cache->num_slots == 0) return false;
+
+    size_t hash = get_hash(tree);
+    pthread_mutex_lock(&cache->lock);
+    NormalFormEntry *entry = &cache->slots[hash % cache->num_slots];
+    bool found = entry->ruleset == ruleset && entry->hash == hash && tree_equals(entry->before, tree);
+    // Entry can be evicted by another thread as soon as lock is released
+    if (found) *out_normal_form = tree_copy(entry->after);
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+/*
+Summary: Stores normal form of tree, evicts entry in same slot
+Params
+    before: Tree before normalization, cache takes ownership
+    after:  Normal form of before, is copied
+*/
+void nfcache_insert(NormalFormCache *cache, const void *ruleset, Node *before, const Node *after)
+{
+    if (cache->num_slots == 0)
+    {
+        free_tree(before);
+        return;
+    }
+
+    size_t hash = get_hash(before);
+    Node *after_copy = tree_copy(after);
+    pthread_mutex_lock(&cache->lock);
+    NormalFormEntry *entry = &cache->slots[hash % cache->num_slots];
+    if (entry->ruleset != NULL) free_entry(entry);
+
+    *entry = (NormalFormEntry){
+        .hash    = hash,
+        .ruleset = ruleset,
+        .before  = before,
+        .after   = after_copy
+    };
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../tree/node.h"
+
+/*
+Bounded cache of normal forms. Entries are keyed by structural hash of the tree before normalization
+and the identity of the ruleset it was normalized with. When a slot is occupied, the old entry is evicted.
+All operations are synchronized, so that concurrent simplifications can share a cache.
+*/
+
+typedef struct
+{
+    size_t hash;         // Hash of before
+    const void *ruleset; // Identity of ruleset, NULL denotes empty slot
+    Node *before;
+    Node *after;
+} NormalFormEntry;
+
+typedef struct
+{
+    size_t num_slots;
+    NormalFormEntry *slots;
+    pthread_mutex_t lock;
+} NormalFormCache;
+
+NormalFormCache nfcache_create(size_t num_slots);
+void nfcache_destroy(NormalFormCache *cache);
+void nfcache_clear(NormalFormCache *cache);
+bool nfcache_lookup(NormalFormCache *cache, const void *ruleset, const Node *tree, Node **out_normal_form);
+void nfcache_insert(NormalFormCache *cache, const void *ruleset, Node *before, const Node *after);
@@ -1,5 +1,8 @@
+#define _POSIX_C_SOURCE 199309L // For clock_gettime
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
+#include <time.h>
 
 #include "../../util/string_util.h"
 #include "../../util/console_util.h"
@@ -10,6 +13,10 @@
 #include "transformation.h"
 #include "matching.h"
 
+#define TASKS_PER_THREAD   4   // More tasks than threads to balance load
+#define PARALLEL_MIN_NODES 256 // Smaller trees are normalized sequentially, threads would not pay off
+#define TRACK_BEST_AFTER   32  // Top-down rewriting remembers smallest tree after this many steps
+
 /*
 Summary: Constructs new rule. Warning: "before" and "after" are not copied, so don't free them!
 */
@@ -20,31 +27,38 @@ bool get_rule(Pattern pattern, Node *after, RewriteRule *out_rule)
     size_t num_var_nodes = count_all_variable_nodes(after);
     if (num_var_nodes > 0)
     {
-        const char *after_vars[MAX_MAPPED_VARS];
-        bool sufficient = false;
-        size_t num_vars_distinct = list_variables(after, MAX_MAPPED_VARS, after_vars, &sufficient);
-
-        if (!sufficient)
-        {
-            return false;
-        }
+        const char **after_vars = malloc_wrapper(num_var_nodes * sizeof(char*));
+        size_t num_vars_distinct = list_variables(after, num_var_nodes, after_vars, NULL);
 
         for (size_t i = 0; i < num_vars_distinct; i++)
         {
             if (get_variable_nodes((const Node**)&pattern.pattern, after_vars[i], 0, NULL) == 0)
             {
+                free(after_vars);
                 return false;
             }
         }
+        free(after_vars);
     }
 
-    const char *free_vars[MAX_MAPPED_VARS];
-    size_t num_free_vars = list_variables(pattern.pattern, MAX_MAPPED_VARS, free_vars, NULL);
+    const char **free_vars = malloc_wrapper((pattern.num_vars + 1) * sizeof(char*));
+    size_t num_free_vars = list_variables(pattern.pattern, pattern.num_vars, free_vars, NULL);
     tree_copy_IDs(after, num_free_vars, free_vars);
+    free(free_vars);
+
+    // Compute cached hashes now, so that rules are only read during rewriting and can be shared among threads
+    get_hash(pattern.pattern);
+    get_hash(after);
+    for (size_t i = 0; i < pattern.constraint_offsets[pattern.num_vars > 0 ? pattern.num_vars : 1]; i++)
+    {
+        get_hash(pattern.constraints[i]);
+    }
 
     *out_rule = (RewriteRule){
         .pattern = pattern,
-        .after  = after,
+        .after   = after,
+        .stats   = calloc_wrapper(1, sizeof(RuleStats)),
+        .group   = 0
     };
     return true;
 }
@@ -56,6 +70,7 @@ void free_rule(RewriteRule *rule)
 {
     free_pattern(&(rule->pattern));
     free_tree(rule->after);
+    free(rule->stats);
 }
 
 // Needed to preserve error information
@@ -71,6 +86,16 @@ void set_tok_index_for_all(Node *tree, size_t index)
     }
 }
 
+// Replaces matched subtree by right hand side of rule, instantiated with matching
+static void rewrite_matched_subtree(Node **matched_subtree, const RewriteRule *rule, const Matching *matching)
+{
+    Node *transformed = tree_copy(rule->after);
+    // Every new node in rhs of rule emerged from root of matched subtree
+    set_tok_index_for_all(transformed, get_token_index(*matched_subtree));
+    transform_by_matching(matching, &transformed);
+    tree_replace(matched_subtree, transformed);
+}
+
 /*
 Summary: Tries to find matching in tree and directly transforms tree by it
 Returns: True when matching could be applied, false otherwise
@@ -81,15 +106,13 @@ bool apply_rule(Node **tree, const RewriteRule *rule, ConstraintChecker checker)
 {
     Matching matching;
     // Try to find matching in tree with pattern specified in rule
+    ProfilerSample sample = profiler_begin();
     Node **matched_subtree = find_matching((const Node**)tree, &rule->pattern, checker, &matching);
+    profiler_end(rule->stats, sample, matched_subtree != NULL);
     if (matched_subtree == NULL) return false;
     // If matching is found, transform tree with it
-    Node *transformed = tree_copy(rule->after);
-    // Every new node in rhs of rule emerged from root of matched subtree
-    set_tok_index_for_all(transformed, get_token_index(*matched_subtree));
-    transform_by_matching(&matching, &transformed);
-    tree_replace(matched_subtree, transformed);
-
+    rewrite_matched_subtree(matched_subtree, rule, &matching);
+    free_matching(&matching);
     return true;
 }
 
@@ -112,17 +135,106 @@ void free_ruleset(Vector *rules)
     vec_destroy(rules);
 }
 
-size_t apply_ruleset(Node **tree, const Vector *ruleset, ConstraintChecker checker, size_t cap)
+// Observed success rate per nanosecond an attempt costs on average.
+// Rules that have not been tried yet get a high score to be tried early.
+static double get_score(const RewriteRule *rule)
 {
-    VectorIterator iterator = vec_get_iterator(ruleset);
-    return apply_ruleset_by_iterator(tree, (Iterator*)&iterator, checker, cap);
+    double attempts = rule->stats->attempts + 1;
+    double success_rate = (rule->stats->successes + 1) / attempts;
+    double cost = (rule->stats->nanos + 1) / attempts;
+    return success_rate / cost;
 }
 
 /*
-Summary: Tries to apply rules (priorized by order) until no rule can be applied any more
-    Guarantees to terminate after MAX_RULESET_ITERATIONS rule appliances
+Summary: Stable-sorts rules by their score within their group. Groups keep their order.
+    Statistics are only collected when profiler is enabled or adaptive.
 */
-size_t apply_ruleset_by_iterator(Node **tree, Iterator *iterator, ConstraintChecker checker, size_t cap)
+void reorder_ruleset(Vector *rules)
+{
+    // Insertion sort, since ruleset is almost sorted after first reordering
+    for (size_t i = 1; i < vec_count(rules); i++)
+    {
+        for (size_t j = i; j > 0; j--)
+        {
+            RewriteRule *prev = (RewriteRule*)vec_get(rules, j - 1);
+            RewriteRule *curr = (RewriteRule*)vec_get(rules, j);
+            if (prev->group != curr->group || get_score(prev) >= get_score(curr)) break;
+
+            RewriteRule temp = *prev;
+            *prev = *curr;
+            *curr = temp;
+        }
+    }
+}
+
+static double get_monotonic_time()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+Summary: Creates budget whose time limit starts now
+Params
+    max_millis: Wall-clock time after which rewriting stops, 0 for no time limit
+*/
+RewriteBudget get_budget(size_t max_steps, size_t max_millis)
+{
+    return (RewriteBudget){
+        .max_steps = max_steps,
+        .deadline  = max_millis == 0 ? INFINITY : get_monotonic_time() + max_millis / 1000.0
+    };
+}
+
+/*
+Returns: True if no more rules should be applied after the given number of steps
+*/
+bool budget_exhausted(const RewriteBudget *budget, size_t steps)
+{
+    return steps >= budget->max_steps
+        || (budget->deadline != INFINITY && get_monotonic_time() >= budget->deadline);
+}
+
+// Tries rules (priorized by order) until one of them can be applied
+static bool apply_first_rule(Node **tree, Iterator *iterator, ConstraintChecker checker)
+{
+    RewriteRule *curr_rule = NULL;
+    while ((curr_rule = (RewriteRule*)iterator_get_next(iterator)) != NULL)
+    {
+        if (apply_rule(tree, curr_rule, checker))
+        {
+            #ifdef DEBUG
+            printf("Applied rule ");
+            print_tree(curr_rule->pattern.pattern, true);
+            printf(" : ");
+            print_tree(*tree, true);
+            printf("\n");
+            #endif
+            iterator_reset(iterator);
+            return true;
+        }
+    }
+    iterator_reset(iterator);
+    return false;
+}
+
+/*
+Summary: Applies rules until no rule can be applied any more or budget is exhausted.
+    A ruleset that does not terminate may pass through smaller trees than the one it is in when it is stopped.
+    Thus, the smallest tree is remembered and restored in this case. Trees of the first steps are not
+    considered, copying them would slow down rulesets that terminate.
+Returns: Number of rule appliances
+Params
+    folder:        Used to fold constant subtrees after each rule appliance. Is allowed to be NULL
+    out_exhausted: Set to true if rewriting was stopped by budget
+*/
+static size_t rewrite_top_down(Node **tree,
+    Iterator *iterator,
+    ConstraintChecker checker,
+    TreeListener folder,
+    const RewriteBudget *budget,
+    bool *out_exhausted)
 {
     #ifdef DEBUG
     printf("Starting with: ");
@@ -130,39 +242,368 @@ size_t apply_ruleset_by_iterator(Node **tree, Iterator *iterator, ConstraintChec
     printf("\n");
     #endif
 
+    // Without a budget tighter than the default one, rewriting is not expected to be interrupted
+    bool track_best = budget->deadline != INFINITY || budget->max_steps < MAX_RULESET_ITERATIONS;
+    Node *best = NULL;
+    size_t best_size = SIZE_MAX;
     size_t counter = 0;
-    while (true)
+    *out_exhausted = false;
+    while (apply_first_rule(tree, iterator, checker))
+    {
+        if (folder != NULL)
+        {
+            // Constant subtrees emerging from a rule appliance need to be folded before the next rule is applied
+            tree_reduce_constant_subtrees(tree, folder, NULL);
+        }
+        counter++;
+
+        if (track_best && counter >= TRACK_BEST_AFTER)
+        {
+            size_t size = tree_count_nodes(*tree);
+            if (size < best_size)
+            {
+                free_tree(best);
+                best = tree_copy(*tree);
+                best_size = size;
+            }
+        }
+
+        if (budget_exhausted(budget, counter))
+        {
+            *out_exhausted = true;
+            if (best != NULL && best_size < tree_count_nodes(*tree))
+            {
+                tree_replace(tree, best);
+                best = NULL;
+            }
+            break;
+        }
+    }
+
+    free_tree(best);
+    return counter;
+}
+
+/*
+Summary: Applies ruleset to tree with given strategy
+Returns: Number of rule appliances
+Params
+    folder: Used to fold constant subtrees after each rule appliance. Is allowed to be NULL
+    cache:  Normal forms are looked up and stored here. Is allowed to be NULL.
+            Must not be used when a rule appliance or folding can be non-deterministic
+    budget: Rewriting stops when it is exhausted, the best tree found so far is kept
+*/
+size_t apply_ruleset(Node **tree,
+    const Vector *ruleset,
+    RewriteStrategy strategy,
+    ConstraintChecker checker,
+    TreeListener folder,
+    NormalFormCache *cache,
+    RewriteBudget budget)
+{
+    if (strategy == STRATEGY_BOTTOM_UP)
+    {
+        return apply_ruleset_bottom_up(tree, ruleset, checker, folder, cache, budget);
+    }
+
+    // Top-down rewriting depends on whole tree, only its normal form can be cached
+    Node *original = NULL;
+    if (cache != NULL)
+    {
+        Node *normal_form;
+        if (nfcache_lookup(cache, ruleset, *tree, &normal_form))
+        {
+            tree_replace(tree, normal_form);
+            return 0;
+        }
+        original = tree_copy(*tree);
+    }
+
+    VectorIterator iterator = vec_get_iterator(ruleset);
+    bool exhausted;
+    size_t counter = rewrite_top_down(tree, (Iterator*)&iterator, checker, folder, &budget, &exhausted);
+
+    if (cache != NULL)
+    {
+        if (!exhausted)
+        {
+            nfcache_insert(cache, ruleset, original, *tree);
+        }
+        else
+        {
+            // Normalization is incomplete
+            free_tree(original);
+        }
+    }
+    return counter;
+}
+
+/*
+Summary: Tries to apply rules (priorized by order) until no rule can be applied any more or budget is exhausted
+Returns: Number of rule appliances
+*/
+size_t apply_ruleset_by_iterator(Node **tree, Iterator *iterator, ConstraintChecker checker, RewriteBudget budget)
+{
+    bool exhausted;
+    return rewrite_top_down(tree, iterator, checker, NULL, &budget, &exhausted);
+}
+
+// On stack during bottom-up normalization
+typedef struct {
+    const Vector *ruleset;
+    ConstraintChecker checker;
+    TreeListener folder;
+    NormalFormCache *cache;
+    size_t mark;    // Nodes with this mark are in normal form
+    RewriteBudget budget;
+    size_t counter;
+    bool exhausted; // Normalization stops as soon as budget is exhausted
+} NormalizationContext;
+
+// Mark of last normalization, each call to apply_ruleset_bottom_up gets a fresh one
+static size_t last_mark = 0;
+static pthread_mutex_t mark_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Marks must be unique among concurrent normalizations, as cached normal forms keep their marks
+static size_t next_mark()
+{
+    pthread_mutex_lock(&mark_lock);
+    size_t res = ++last_mark;
+    pthread_mutex_unlock(&mark_lock);
+    return res;
+}
+
+// Replaces operator node by constant when all of its children are constant
+static void fold_locally(NormalizationContext *ctx, Node **tree)
+{
+    if (ctx->folder == NULL || get_type(*tree) != NTYPE_OPERATOR) return;
+    for (size_t i = 0; i < get_num_children(*tree); i++)
+    {
+        if (get_type(get_child(*tree, i)) != NTYPE_CONSTANT) return;
+    }
+
+    double res;
+    if (tree_reduce(*tree, ctx->folder, &res, NULL) == LISTENERERR_SUCCESS)
     {
+        tree_replace(tree, malloc_constant_node(res, get_token_index(*tree)));
+    }
+}
+
+static void normalize_uncached(NormalizationContext *ctx, Node **tree);
+
+// Replaces tree by its cached normal form. Lookup only needs the hash, which is cached in the nodes.
+static bool normalize_from_cache(NormalizationContext *ctx, Node **tree)
+{
+    // Leafs are cheap to normalize, don't pollute cache with them
+    if (ctx->cache == NULL || get_type(*tree) != NTYPE_OPERATOR) return false;
+
+    Node *normal_form;
+    if (!nfcache_lookup(ctx->cache, ctx->ruleset, *tree, &normal_form)) return false;
+    tree_replace(tree, normal_form);
+    set_mark(*tree, ctx->mark);
+    return true;
+}
+
+static void normalize(NormalizationContext *ctx, Node **tree)
+{
+    if (get_mark(*tree) == ctx->mark) return;
+    if (!normalize_from_cache(ctx, tree)) normalize_uncached(ctx, tree);
+}
+
+// Like normalize, but normal form is inserted into the cache. Only done for the whole tree, since it is copied.
+static void normalize_root(NormalizationContext *ctx, Node **tree)
+{
+    if (get_mark(*tree) == ctx->mark || normalize_from_cache(ctx, tree)) return;
+    if (ctx->cache == NULL || get_type(*tree) != NTYPE_OPERATOR)
+    {
+        normalize_uncached(ctx, tree);
+        return;
+    }
+
+    Node *original = tree_copy(*tree);
+    normalize_uncached(ctx, tree);
+    if (!ctx->exhausted)
+    {
+        nfcache_insert(ctx->cache, ctx->ruleset, original, *tree);
+    }
+    else
+    {
+        free_tree(original);
+    }
+}
+
+static void normalize_uncached(NormalizationContext *ctx, Node **tree)
+{
+    while (get_mark(*tree) != ctx->mark)
+    {
+        if (get_type(*tree) == NTYPE_OPERATOR)
+        {
+            for (size_t i = 0; i < get_num_children(*tree); i++)
+            {
+                normalize(ctx, get_child_addr(*tree, i));
+                if (ctx->exhausted) return;
+            }
+            fold_locally(ctx, tree);
+        }
+
+        // Children are in normal form, so rules only need to be tried at root
         bool applied_flag = false;
-        RewriteRule *curr_rule = NULL;
-        while ((curr_rule = (RewriteRule*)iterator_get_next(iterator)) != NULL)
+        for (size_t i = 0; i < vec_count(ctx->ruleset); i++)
         {
-            if (apply_rule(tree, curr_rule, checker))
+            RewriteRule *curr_rule = (RewriteRule*)vec_get(ctx->ruleset, i);
+            Matching matching;
+            ProfilerSample sample = profiler_begin();
+            bool matched = get_matching((const Node**)tree, &curr_rule->pattern, ctx->checker, &matching);
+            profiler_end(curr_rule->stats, sample, matched);
+            if (matched)
             {
-                #ifdef DEBUG
-                printf("Applied rule ");
-                print_tree(curr_rule->pattern.pattern, true);
-                printf(" : ");
-                print_tree(*tree, true);
-                printf("\n");
-                #endif
+                // Subtrees bound to variables keep their mark when copied into rhs
+                rewrite_matched_subtree(tree, curr_rule, &matching);
+                free_matching(&matching);
                 applied_flag = true;
-                counter++;
+                ctx->counter++;
+                ctx->exhausted = budget_exhausted(&ctx->budget, ctx->counter);
                 break;
             }
         }
-        iterator_reset(iterator);
+
         if (!applied_flag)
         {
-            return counter;
+            set_mark(*tree, ctx->mark);
         }
         else
         {
-            if (counter == cap)
-            {
-                return counter;
-            }
+            if (ctx->exhausted) return;
         }
     }
-    return 0; // To make compiler happy
+}
+
+/*
+Summary: Innermost rewriting. Normalizes children before their parent, normalized subtrees are marked and never
+    revisited. Only suitable for rulesets whose result does not depend on the position rules are tried at first.
+    Since the normal form of a subtree does not depend on its context, normal forms of all subtrees are looked up.
+    Only the normal form of the whole tree is inserted into the cache.
+Returns: Number of rule appliances
+Params
+    folder: Used to fold operators with only constant children. Is allowed to be NULL
+    cache:  Is allowed to be NULL
+    budget: When exhausted, the tree is left as far as it is normalized
+*/
+size_t apply_ruleset_bottom_up(Node **tree,
+    const Vector *ruleset,
+    ConstraintChecker checker,
+    TreeListener folder,
+    NormalFormCache *cache,
+    RewriteBudget budget)
+{
+    NormalizationContext ctx = (NormalizationContext){
+        .ruleset  = ruleset,
+        .checker  = checker,
+        .folder   = folder,
+        .cache    = cache,
+        .mark      = next_mark(),
+        .budget    = budget,
+        .counter   = 0,
+        .exhausted = false
+    };
+
+    normalize_root(&ctx, tree);
+    return ctx.counter;
+}
+
+// Independent subtree, normalized by a thread of a pool
+typedef struct {
+    NormalizationContext ctx;
+    Node **tree;
+} NormalizationTask;
+
+static void normalization_task(void *arg)
+{
+    NormalizationTask *task = (NormalizationTask*)arg;
+    normalize(&task->ctx, task->tree);
+}
+
+// Splits tree into disjoint operator subtrees of at most grain nodes. Leafs above them are left out.
+static void collect_subtrees(Node **tree, size_t grain, Vector *out_subtrees)
+{
+    if (get_type(*tree) != NTYPE_OPERATOR) return;
+    if (tree_count_nodes(*tree) <= grain)
+    {
+        VEC_PUSH_ELEM(out_subtrees, Node**, tree);
+        return;
+    }
+
+    // Hash of a node above subtrees becomes invalid when they are rewritten.
+    // Invalidate it now, so threads stop invalidation at it and don't write it concurrently.
+    invalidate_hash(*tree);
+    for (size_t i = 0; i < get_num_children(*tree); i++)
+    {
+        collect_subtrees(get_child_addr(*tree, i), grain, out_subtrees);
+    }
+}
+
+/*
+Summary: Like apply_ruleset_bottom_up, but independent subtrees (e.g. the arguments of a large sum) are normalized
+    concurrently by the threads of pool. Afterwards, the rest of the tree is normalized sequentially.
+    Results are equal since normal forms of subtrees do not depend on their context.
+    Falls back to sequential normalization for small trees or when rule statistics are collected,
+    as they are not synchronized.
+Returns: Number of rule appliances
+Params
+    cache: Only used in sequential pass. Is allowed to be NULL
+    budget: Step limit applies to each subtree and to sequential pass separately, deadline is shared
+*/
+size_t apply_ruleset_bottom_up_parallel(Node **tree,
+    const Vector *ruleset,
+    ConstraintChecker checker,
+    TreeListener folder,
+    NormalFormCache *cache,
+    RewriteBudget budget,
+    ThreadPool *pool)
+{
+    if (profiler_is_enabled() || profiler_is_adaptive() || tree_count_nodes(*tree) < PARALLEL_MIN_NODES)
+    {
+        return apply_ruleset_bottom_up(tree, ruleset, checker, folder, cache, budget);
+    }
+
+    NormalizationContext ctx = (NormalizationContext){
+        .ruleset  = ruleset,
+        .checker  = checker,
+        .folder   = folder,
+        .cache    = cache,
+        .mark      = next_mark(),
+        .budget    = budget,
+        .counter   = 0,
+        .exhausted = false
+    };
+
+    Vector subtrees = vec_create(sizeof(Node**), pool_num_threads(pool) * TASKS_PER_THREAD);
+    collect_subtrees(tree, tree_count_nodes(*tree) / (pool_num_threads(pool) * TASKS_PER_THREAD) + 1, &subtrees);
+
+    size_t num_tasks = vec_count(&subtrees);
+    NormalizationTask *tasks = malloc_wrapper(num_tasks * sizeof(NormalizationTask));
+    void **args = malloc_wrapper(num_tasks * sizeof(void*));
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        // Lookups of every subtree would contend for the lock of the cache
+        tasks[i] = (NormalizationTask){ .ctx = ctx, .tree = *(Node***)vec_get(&subtrees, i) };
+        tasks[i].ctx.cache = NULL;
+        args[i] = &tasks[i];
+    }
+    pool_run(pool, normalization_task, num_tasks, args);
+
+    size_t counter = 0;
+    bool exhausted = false;
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+        counter += tasks[i].ctx.counter;
+        exhausted |= tasks[i].ctx.exhausted;
+    }
+    free(tasks);
+    free(args);
+    vec_destroy(&subtrees);
+
+    // Subtrees are marked as normalized, so only nodes above them are visited
+    if (!exhausted) normalize_root(&ctx, tree);
+    return counter + ctx.counter;
 }
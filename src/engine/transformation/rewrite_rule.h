@@ -1,21 +1,68 @@
 #pragma once
 #include "matching.h"
+#include "normal_form_cache.h"
+#include "rule_profiler.h"
 #include "../../util/vector.h"
 #include "../../util/iterator.h"
+#include "../../util/thread_pool.h"
 #include "../tree/node.h"
+#include "../tree/tree_util.h"
 
 typedef struct
 {
     Pattern pattern;
     Node *after;
+    RuleStats *stats; // Collected when profiler is enabled
+    size_t group;     // Rules of same group can be reordered without changing the result
 } RewriteRule;
 
+#define MAX_RULESET_ITERATIONS 10000 // Step budget of rulesets whose caller does not impose a tighter one
+
+/*
+Summary: Limits a ruleset appliance. When it is exhausted, rewriting stops and the best tree found so far is kept.
+*/
+typedef struct
+{
+    size_t max_steps; // Maximum number of rule appliances
+    double deadline;  // Monotonic time in seconds after which no more rules are applied, INFINITY if none
+} RewriteBudget;
+
+typedef enum {
+    STRATEGY_TOP_DOWN, // Rules priorized by order, each rule is searched for in whole tree (outermost first)
+    STRATEGY_BOTTOM_UP // Innermost: children are normalized before their parent and never revisited
+} RewriteStrategy;
+
 bool get_rule(Pattern pattern, Node *after, RewriteRule *out_rule);
 void free_rule(RewriteRule *rule);
+void set_tok_index_for_all(Node *tree, size_t index);
 bool apply_rule(Node **tree, const RewriteRule *rule, ConstraintChecker checker);
 
 Vector get_empty_ruleset();
 void add_to_ruleset(Vector *rules, RewriteRule rule);
 void free_ruleset(Vector *rules);
-size_t apply_ruleset(Node **tree, const Vector *ruleset, ConstraintChecker checker, size_t cap);
-size_t apply_ruleset_by_iterator(Node **tree, Iterator *iterator, ConstraintChecker checker, size_t cap);
+void reorder_ruleset(Vector *rules);
+
+RewriteBudget get_budget(size_t max_steps, size_t max_millis);
+bool budget_exhausted(const RewriteBudget *budget, size_t steps);
+
+size_t apply_ruleset(Node **tree,
+    const Vector *ruleset,
+    RewriteStrategy strategy,
+    ConstraintChecker checker,
+    TreeListener folder,
+    NormalFormCache *cache,
+    RewriteBudget budget);
+size_t apply_ruleset_by_iterator(Node **tree, Iterator *iterator, ConstraintChecker checker, RewriteBudget budget);
+size_t apply_ruleset_bottom_up(Node **tree,
+    const Vector *ruleset,
+    ConstraintChecker checker,
+    TreeListener folder,
+    NormalFormCache *cache,
+    RewriteBudget budget);
+size_t apply_ruleset_bottom_up_parallel(Node **tree,
+    const Vector *ruleset,
+    ConstraintChecker checker,
+    TreeListener folder,
+    NormalFormCache *cache,
+    RewriteBudget budget,
+    ThreadPool *pool);
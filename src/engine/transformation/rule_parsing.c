@@ -17,31 +17,29 @@ Could be heap but could also be string literal that is readonly
 
 #define COMMENT_PREFIX "#"
 #define RULESET        "RULESET"
+#define UNORDERED      "UNORDERED"
+#define BARRIER        "BARRIER"
 #define ARROW          "->"
 #define WHERE          " WHERE "
 #define AND            " ; "
 
-void report_pattern_errcode(int err_code)
+static void free_constraints(Vector *constraints)
 {
-    switch (err_code)
+    for (size_t i = 0; i < vec_count(constraints); i++)
     {
-        case MAX_MAPPED_VARS_EXCEEDED:
-            report_error("Trying to preprocess a pattern with too many distinct variables. Increase MAX_MAPPED_VARS.\n");
-            return;
-        case MATCHING_MAX_CONSTRAINTS_EXCEEDED:
-            report_error("Trying to preprocess a pattern with too many constraints. Increase MATCHING_MAX_CONSTRAINTS.\n");
+        free_tree(*(Node**)vec_get(constraints, i));
     }
+    vec_destroy(constraints);
 }
 
 // string: without "WHERE"
+// out_constraints: Vector of Node*, parsed constraints are appended to it
 bool parse_constraints(const char *string,
     const ParsingContext *ctx,
-    size_t *num_constraints, // In-Out, like in getline
-    Node **out_constraints)
+    Vector *out_constraints)
 {
     if (string == NULL)
     {
-        *num_constraints = 0;
         return true;
     }
 
@@ -49,8 +47,6 @@ bool parse_constraints(const char *string,
     char *str = str_cpy;
     strcpy(str, string);    
 
-    size_t buffer_size = *num_constraints;
-    *num_constraints = 0;
     while (str != NULL)
     {
         char *next_and = strstr(str, AND);
@@ -60,14 +56,12 @@ bool parse_constraints(const char *string,
             next_and += strlen(AND);
         }
 
-        out_constraints[*num_constraints] = parse_easy(ctx, str);
-        if (out_constraints[*num_constraints] == NULL) goto error;
-        (*num_constraints)++;
-        if (*num_constraints == buffer_size) goto success;
+        Node *constraint = parse_easy(ctx, str);
+        if (constraint == NULL) goto error;
+        VEC_PUSH_ELEM(out_constraints, Node*, constraint);
         str = next_and;
     }
 
-    success:
     free(str_cpy);
     return true;
     error:
@@ -83,14 +77,13 @@ bool parse_pattern(const char *string, const ParsingContext *ctx, Pattern *out_p
     strcpy(str_cpy, string);
 
     char *where_pos = strstr(str, WHERE); // Optional
-    size_t num_constrs = MATCHING_MAX_CONSTRAINTS;
-    Node *constrs[MATCHING_MAX_CONSTRAINTS];
+    Vector constrs = vec_create(sizeof(Node*), 1);
     if (where_pos != NULL)
     {
         *where_pos = '\0';
         where_pos += strlen(WHERE);
     }
-    if (!parse_constraints(where_pos, ctx, &num_constrs, constrs))
+    if (!parse_constraints(where_pos, ctx, &constrs))
     {
         goto error;
     }
@@ -101,16 +94,13 @@ bool parse_pattern(const char *string, const ParsingContext *ctx, Pattern *out_p
         goto error;
     }
 
-    int err_code = get_pattern(pattern, num_constrs, constrs, out_pattern);
-    if (err_code != 0)
-    {
-        report_pattern_errcode(err_code);
-        goto error;
-    }
+    get_pattern(pattern, vec_count(&constrs), (Node**)constrs.buffer, out_pattern);
+    vec_destroy(&constrs);
     free(str_cpy);
     return true;
 
     error:
+    free_constraints(&constrs);
     free(str_cpy);
     return false;
 }
@@ -124,7 +114,7 @@ bool parse_rule(const char *string, const ParsingContext *ctx, RewriteRule *out_
     char *where_pos = strstr(str, WHERE); // Optional
     Node *left_n = NULL;
     Node *right_n = NULL;
-    size_t num_constrs = 0;
+    Vector constrs = vec_create(sizeof(Node*), 1);
 
     if (arrow_pos == NULL)
     {
@@ -136,15 +126,13 @@ bool parse_rule(const char *string, const ParsingContext *ctx, RewriteRule *out_
     arrow_pos[0] = '\0';
     arrow_pos += strlen(ARROW);
 
-    Node *constrs[MATCHING_MAX_CONSTRAINTS];
     if (where_pos != NULL)
     {
         *where_pos = '\0';
         where_pos += strlen(WHERE);
     }
 
-    num_constrs = MATCHING_MAX_CONSTRAINTS;
-    if (!parse_constraints(where_pos, ctx, &num_constrs, constrs)) goto error;
+    if (!parse_constraints(where_pos, ctx, &constrs)) goto error;
 
     left_n = parse_easy(ctx, str); // Gives error message
     if (left_n == NULL)
@@ -159,16 +147,15 @@ bool parse_rule(const char *string, const ParsingContext *ctx, RewriteRule *out_
     }
 
     Pattern pattern;
-    int err_code = get_pattern(left_n, num_constrs, constrs, &pattern);
-    if (err_code != 0)
-    {
-        report_pattern_errcode(err_code);
-        goto error;
-    }
+    get_pattern(left_n, vec_count(&constrs), (Node**)constrs.buffer, &pattern);
+    vec_destroy(&constrs);
     if (!get_rule(pattern, right_n, out_rule))
     {
         report_error("Unbounded variable in righthand side of rule.\n");
-        goto error;
+        free_pattern(&pattern);
+        free_tree(right_n);
+        free(str);
+        return false;
     }
 
     free(str);
@@ -178,7 +165,7 @@ bool parse_rule(const char *string, const ParsingContext *ctx, RewriteRule *out_
     free(str);
     free_tree(left_n);
     free_tree(right_n);
-    for (size_t i = 0; i < num_constrs; i++) free_tree(constrs[i]);
+    free_constraints(&constrs);
     return false;
 }
 
@@ -188,6 +175,8 @@ ssize_t parse_rulesets_from_file(FILE *file,
     Vector *out_rulesets)
 {
     ssize_t curr_ruleset = -1;
+    bool unordered = false; // Rules of unordered rulesets can be reordered, but not across barriers
+    size_t group = 0;
     size_t line_index = 0;
     char *line_start = NULL;
     size_t line_length = 0;
@@ -205,6 +194,8 @@ ssize_t parse_rulesets_from_file(FILE *file,
         if (begins_with(RULESET, line))
         {
             curr_ruleset++;
+            unordered = strstr(line + strlen(RULESET), UNORDERED) != NULL;
+            group = 0;
             continue;
         }
 
@@ -216,13 +207,22 @@ ssize_t parse_rulesets_from_file(FILE *file,
 
         if (line[0] == '\0') continue;
 
+        if (begins_with(BARRIER, line))
+        {
+            group++;
+            continue;
+        }
+
         if (curr_ruleset != -1)
         {
-            if (!parse_rule(line, ctx, vec_push_empty(&out_rulesets[curr_ruleset])))
+            RewriteRule *rule = vec_push_empty(&out_rulesets[curr_ruleset]);
+            if (!parse_rule(line, ctx, rule))
             {
                 report_error("Error occurred in line %zu: %s.\n", line_index, line);
                 goto error;
             }
+            // Every rule of an ordered ruleset is a group on its own
+            rule->group = unordered ? group : group++;
         }
         else
         {
@@ -0,0 +1,63 @@
+#define _POSIX_C_SOURCE 199309L // For clock_gettime
+#include <time.h>
+#include "rule_profiler.h"
+#include "matching.h"
+
+static bool enabled = false;  // Statistics are shown to user
+static bool adaptive = false; // Statistics are used to reorder rules
+
+void profiler_set_enabled(bool value)
+{
+    enabled = value;
+}
+
+bool profiler_is_enabled()
+{
+    return enabled;
+}
+
+void profiler_set_adaptive(bool value)
+{
+    adaptive = value;
+}
+
+bool profiler_is_adaptive()
+{
+    return adaptive;
+}
+
+// Monotonic clock is read in user space, clock() would be a system call that costs more than many matchings
+static uint64_t get_nanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/*
+Summary: Call before rule is tried. Does nothing when profiler is neither enabled nor adaptive.
+*/
+ProfilerSample profiler_begin()
+{
+    if (!enabled && !adaptive) return (ProfilerSample){ .active = false };
+    return (ProfilerSample){
+        .active            = true,
+        .start             = get_nanos(),
+        .partial_matchings = get_num_partial_matchings()
+    };
+}
+
+/*
+Summary: Call after rule has been tried to add the try to statistics of rule
+Params
+    sample:  Returned by profiler_begin
+    success: Whether a matching has been found
+*/
+void profiler_end(RuleStats *stats, ProfilerSample sample, bool success)
+{
+    if (!sample.active) return;
+    stats->attempts++;
+    if (success) stats->successes++;
+    stats->partial_matchings += get_num_partial_matchings() - sample.partial_matchings;
+    stats->nanos += get_nanos() - sample.start;
+}
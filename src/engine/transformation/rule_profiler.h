@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+Profiler for rewrite rules. When enabled, each try to match a rule is recorded in the statistics of the rule.
+Statistics are also collected in adaptive mode, in which rulesets are reordered by them.
+*/
+
+typedef struct
+{
+    size_t attempts;          // Number of times rule was tried
+    size_t successes;         // Number of times a matching was found
+    size_t partial_matchings; // Number of partial matchings constructed while trying rule
+    uint64_t nanos;           // Wall-clock time spent on matching
+} RuleStats;
+
+// Taken before rule is tried
+typedef struct
+{
+    bool active;
+    uint64_t start; // Monotonic time in nanoseconds
+    size_t partial_matchings;
+} ProfilerSample;
+
+void profiler_set_enabled(bool value);
+bool profiler_is_enabled();
+void profiler_set_adaptive(bool value);
+bool profiler_is_adaptive();
+ProfilerSample profiler_begin();
+void profiler_end(RuleStats *stats, ProfilerSample sample, bool success);
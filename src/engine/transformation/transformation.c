@@ -11,9 +11,9 @@ static void transform_matched_recursive(const Matching *matching, Node **parent)
         Node *child = get_child(*parent, i);
         if (get_type(child) == NTYPE_VARIABLE)
         {
-            size_t id = get_id(child);
-            tree_replace_by_list(parent, i, matching->mapped_nodes[id]);
-            i += matching->mapped_nodes[id].size - 1;
+            const NodeList *nodes = get_mapped_nodes(matching, get_id(child));
+            tree_replace_by_list(parent, i, *nodes);
+            i += nodes->size - 1;
         }
         else
         {
@@ -40,11 +40,12 @@ void transform_by_matching(const Matching *matching, Node **to_transform)
     {
         if (get_type(*to_transform) == NTYPE_VARIABLE)
         {
-            if (matching->mapped_nodes[get_id(*to_transform)].size != 1) 
+            const NodeList *nodes = get_mapped_nodes(matching, get_id(*to_transform));
+            if (nodes->size != 1) 
             {
                 software_defect("Trying to replace root with a list != 1.\n");
             }
-            tree_replace(to_transform, tree_copy(matching->mapped_nodes[get_id(*to_transform)].nodes[0]));
+            tree_replace(to_transform, tree_copy(nodes->nodes[0]));
         }
     }
 }
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stdint.h>
 #include "../util/alloc_wrappers.h"
 #include "../util/console_util.h"
 #include "node.h"
@@ -6,6 +7,10 @@
 struct Node {
     NodeType type;
     size_t token_index;
+    size_t mark;      // Used by traversals to recognize already visited subtrees, 0 when unmarked
+    Node *parent;     // NULL for root, needed to invalidate hashes of ancestors
+    size_t hash;      // Structural hash, only valid when hash_valid is set
+    bool hash_valid;  // When false, hash_valid is also false for all ancestors
 };
 
 typedef struct {
@@ -35,6 +40,9 @@ Node *malloc_variable_node(const char *var_name, size_t id, size_t tok_index)
     VariableNode *res = malloc_wrapper(sizeof(VariableNode) + (strlen(var_name) + 1) * sizeof(char));
     res->base.type = NTYPE_VARIABLE;
     res->base.token_index = tok_index;
+    res->base.mark = 0;
+    res->base.parent = NULL;
+    res->base.hash_valid = false;
     res->id = id;
     strcpy(res->var_name, var_name);
     return (Node*)res;
@@ -45,6 +53,9 @@ Node *malloc_constant_node(double value, size_t tok_index)
     ConstantNode *res = malloc_wrapper(sizeof(ConstantNode));
     res->base.type = NTYPE_CONSTANT;
     res->base.token_index = tok_index;
+    res->base.mark = 0;
+    res->base.parent = NULL;
+    res->base.hash_valid = false;
     res->const_value = value;
     return (Node*)res;
 }
@@ -55,6 +66,9 @@ Node *malloc_operator_node(const Operator *op, size_t num_children, size_t tok_i
     for (size_t i = 0; i < num_children; i++) res->children[i] = NULL;
     res->base.type = NTYPE_OPERATOR;
     res->base.token_index = tok_index;
+    res->base.mark = 0;
+    res->base.parent = NULL;
+    res->base.hash_valid = false;
     res->op = op;
     res->num_children = num_children;
     return (Node*)res;
@@ -88,6 +102,103 @@ void set_token_index(Node *node, size_t token_index)
     node->token_index = token_index;
 }
 
+// Hashes of ancestors depend on hash of node, so they are invalidated as well
+void invalidate_hash(Node *node)
+{
+    // Stop at first invalid node since all of its ancestors are invalid already
+    while (node != NULL && node->hash_valid)
+    {
+        node->hash_valid = false;
+        node = node->parent;
+    }
+}
+
+// Combines hash values, see boost::hash_combine
+static size_t hash_combine(size_t seed, size_t value)
+{
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+static size_t hash_string(const char *str)
+{
+    // FNV-1a
+    size_t res = 2166136261u;
+    while (*str != '\0')
+    {
+        res = (res ^ (unsigned char)*str) * 16777619u;
+        str++;
+    }
+    return res;
+}
+
+/*
+Summary: Structural hash of tree. Computed lazily and cached in each node,
+    set_child and set_parent invalidate cached hashes of all ancestors.
+Returns: Hash value that is equal for trees that are equal in terms of tree_equals
+*/
+size_t get_hash(const Node *node)
+{
+    if (node == NULL) return 0;
+    if (node->hash_valid) return node->hash;
+
+    size_t res = node->type;
+    switch (node->type)
+    {
+        case NTYPE_CONSTANT:
+        {
+            double value = get_const_value(node);
+            if (value == 0) value = 0; // 0 and -0 are equal
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(double));
+            res = hash_combine(res, (size_t)(bits ^ (bits >> 32)));
+            break;
+        }
+
+        case NTYPE_VARIABLE:
+            res = hash_combine(res, hash_string(get_var_name(node)));
+            break;
+
+        case NTYPE_OPERATOR:
+            res = hash_combine(res, get_op(node)->id);
+            res = hash_combine(res, get_num_children(node));
+            for (size_t i = 0; i < get_num_children(node); i++)
+            {
+                res = hash_combine(res, get_hash(get_child(node, i)));
+            }
+    }
+
+    // Hash is a cache, thus it can be set for const nodes
+    ((Node*)node)->hash = res;
+    ((Node*)node)->hash_valid = true;
+    return res;
+}
+
+Node *get_parent(const Node *node)
+{
+    return node->parent;
+}
+
+/*
+Summary: Needs to be called when a node is inserted by overwriting a child slot directly,
+    e.g. via get_child_addr, to keep cached hashes of parent and its ancestors valid
+*/
+void set_parent(Node *node, Node *parent)
+{
+    if (node == NULL) return;
+    node->parent = parent;
+    invalidate_hash(parent);
+}
+
+size_t get_mark(const Node *node)
+{
+    return node->mark;
+}
+
+void set_mark(Node *node, size_t mark)
+{
+    node->mark = mark;
+}
+
 const Operator *get_op(const Node *node)
 {
     return ((OperatorNode*)node)->op;
@@ -96,6 +207,7 @@ const Operator *get_op(const Node *node)
 void set_op(Node *node, const Operator *op)
 {
     ((OperatorNode*)node)->op = op;
+    invalidate_hash(node);
 }
 
 size_t get_num_children(const Node *node)
@@ -116,6 +228,8 @@ Node **get_child_addr(const Node *node, size_t index)
 void set_child(Node *node, size_t index, Node *child)
 {
     ((OperatorNode*)node)->children[index] = child;
+    if (child != NULL) child->parent = node;
+    invalidate_hash(node);
 }
 
 const char *get_var_name(const Node *node)
@@ -33,6 +33,12 @@ void free_tree(Node *tree);
 NodeType get_type(const Node *node);
 size_t get_token_index(const Node *node);
 void set_token_index(Node *node, size_t token_index);
+size_t get_hash(const Node *node);
+void invalidate_hash(Node *node);
+Node *get_parent(const Node *node);
+void set_parent(Node *node, Node *parent);
+size_t get_mark(const Node *node);
+void set_mark(Node *node, size_t mark);
 const Operator *get_op(const Node *node);
 void set_op(Node *node, const Operator *op);
 size_t get_num_children(const Node *node);
@@ -49,3 +49,42 @@ Operator op_get_constant(const char *name)
 {
     return op_get_function(name, 0);
 }
+
+/*
+Summary: Attaches evaluation function to operator
+Params
+    pure: False if result depends on state (e.g. history or random numbers), true otherwise
+*/
+Operator op_set_evaluation(Operator op, OpEvaluation evaluate, bool pure)
+{
+    op.evaluate = evaluate;
+    op.pure     = pure;
+    return op;
+}
+
+Operator op_from_descriptor(const OpDescriptor *desc)
+{
+    Operator res;
+    switch (desc->placement)
+    {
+        case OP_PLACE_PREFIX:
+            res = op_get_prefix(desc->name, desc->precedence);
+            break;
+        case OP_PLACE_INFIX:
+            res = op_get_infix(desc->name, desc->precedence, desc->assoc);
+            break;
+        case OP_PLACE_POSTFIX:
+            res = op_get_postfix(desc->name, desc->precedence);
+            break;
+        default:
+            res = op_get_function(desc->name, desc->arity);
+    }
+    return op_set_evaluation(res, desc->evaluate, desc->pure);
+}
+
+OpArityClass op_get_arity_class(const Operator *op)
+{
+    if (op->arity == 0) return OP_ARITY_CONSTANT;
+    if (op->arity == OP_DYNAMIC_ARITY) return OP_ARITY_DYNAMIC;
+    return OP_ARITY_FIXED;
+}
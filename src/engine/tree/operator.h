@@ -1,5 +1,6 @@
 #pragma once
 #include <stdlib.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <limits.h>
 
@@ -8,6 +9,10 @@
 #define OP_NUM_PLACEMENTS 4
 
 typedef unsigned char Precedence;
+typedef int ListenerError;
+
+// Computes result of an operator from the values of its operands
+typedef ListenerError (*OpEvaluation)(size_t num_args, const double *args, double *out);
 
 typedef enum {
     OP_ASSOC_RIGHT,
@@ -21,6 +26,12 @@ typedef enum {
     OP_PLACE_FUNCTION,
 } OpPlacement;
 
+typedef enum {
+    OP_ARITY_CONSTANT, // No operands
+    OP_ARITY_FIXED,    // Given number of operands
+    OP_ARITY_DYNAMIC,  // Arbitrary number of operands
+} OpArityClass;
+
 typedef struct {
     char *name;
     size_t id; // For easier lookup
@@ -28,10 +39,26 @@ typedef struct {
     Precedence precedence;
     OpAssociativity assoc;
     OpPlacement placement;
+    OpEvaluation evaluate; // NULL if operator has no numerical value
+    bool pure;             // Result only depends on operands, operator can be evaluated ahead of time
 } Operator;
 
+// Compact description of an operator, e.g. for tables of built-in operators
+typedef struct {
+    const char *name;
+    OpPlacement placement;
+    size_t arity;          // Of functions
+    Precedence precedence; // Of prefix, infix and postfix operators
+    OpAssociativity assoc; // Of infix operators
+    OpEvaluation evaluate;
+    bool pure;
+} OpDescriptor;
+
 Operator op_get_function(const char *name, size_t arity);
 Operator op_get_prefix(const char *name, Precedence precedence);
 Operator op_get_infix(const char *name, Precedence precedence, OpAssociativity assoc);
 Operator op_get_postfix(const char *name, Precedence precedence);
 Operator op_get_constant(const char *name);
+Operator op_set_evaluation(Operator op, OpEvaluation evaluate, bool pure);
+Operator op_from_descriptor(const OpDescriptor *desc);
+OpArityClass op_get_arity_class(const Operator *op);
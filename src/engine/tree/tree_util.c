@@ -1,9 +1,12 @@
 #include <string.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include "../util/alloc_wrappers.h"
 #include "tree_util.h"
 #include "node.h"
 
+#define REDUCE_INLINE_ARGS 8 // Operands of reduced operators with fewer children are held on call stack
+
 /*
 Summary: Copies tree, tree_equals(tree, copy) will return true. Source tree can be safely free'd afterwards.
 Params
@@ -33,6 +36,8 @@ Node *tree_copy(const Node *tree)
             break;
     }
     
+    // A copy represents the same expression, so it is as normalized as the original
+    set_mark(res, get_mark(tree));
     return res;
 }
 
@@ -43,6 +48,9 @@ Returns: True iff trees are equal
 bool tree_equals(const Node *a, const Node *b)
 {
     if (a == NULL || b == NULL) return false;
+    if (a == b) return true;
+    // Cached hashes reject most unequal trees in O(1)
+    if (get_hash(a) != get_hash(b)) return false;
     if (get_type(a) != get_type(b)) return false;
     
     switch (get_type(a))
@@ -76,8 +84,10 @@ Summary: Frees *tree_to_replace and assigns tree_to_insert to tree_to_replace
 */
 void tree_replace(Node **tree_to_replace, Node *tree_to_insert)
 {
+    Node *parent = *tree_to_replace != NULL ? get_parent(*tree_to_replace) : NULL;
     free_tree(*tree_to_replace);
     *tree_to_replace = tree_to_insert;
+    set_parent(tree_to_insert, parent);
 }
 
 /*
@@ -108,6 +118,7 @@ void tree_replace_by_list(Node **parent, size_t child_to_replace, NodeList list)
                 child_to_replace + list.size + i,
                 get_child(*parent, child_to_replace + i + 1));
         }
+        set_parent(new_parent, get_parent(*parent));
         free(*parent);
         *parent = new_parent;
     }
@@ -117,6 +128,22 @@ void tree_replace_by_list(Node **parent, size_t child_to_replace, NodeList list)
     }
 }
 
+/*
+Returns: Number of nodes in tree, i.e. its size
+*/
+size_t tree_count_nodes(const Node *tree)
+{
+    size_t res = 1;
+    if (get_type(tree) == NTYPE_OPERATOR)
+    {
+        for (size_t i = 0; i < get_num_children(tree); i++)
+        {
+            res += tree_count_nodes(get_child(tree, i));
+        }
+    }
+    return res;
+}
+
 /*
 Returns: Total number of variable nodes in tree.
     Can be used as an upper bound for the needed size of a buffer to supply to get_variable_nodes
@@ -362,45 +389,84 @@ size_t replace_variable_nodes(Node **tree, const Node *tree_to_copy, const char
 /* ~ ~ ~ ~ ~ ~ ~ ~ ~ Traversal ~ ~ ~ ~ ~ ~ ~ ~ ~ */
 
 /*
-Summary: Evaluates operator tree
-Returns: True if reduction could be applied, i.e. no variable in tree and reduction-function did not return false
-Params
-    tree:      Tree to reduce to a constant
-    reduction: Function that takes an operator, number of children, and pointer to number of children many child values
-    out:       Reduction result
+Operand stack of tree_reduce. Each thread reuses its own one, it is freed when the thread exits.
+An evaluation that is started by a listener while the stack is in use gets a temporary one.
 */
-ListenerError tree_reduce(const Node *tree, TreeListener listener, double *out, const Node **out_errnode)
+typedef struct {
+    double *values;
+    size_t capacity;
+    bool in_use;
+} OperandStack;
+
+static pthread_key_t operand_stack_key;
+static pthread_once_t operand_stack_once = PTHREAD_ONCE_INIT;
+
+static void free_operand_stack(void *stack)
+{
+    free(((OperandStack*)stack)->values);
+    free(stack);
+}
+
+static void create_operand_stack_key()
+{
+    pthread_key_create(&operand_stack_key, free_operand_stack);
+}
+
+static OperandStack *get_operand_stack()
+{
+    pthread_once(&operand_stack_once, create_operand_stack_key);
+    OperandStack *stack = pthread_getspecific(operand_stack_key);
+    if (stack == NULL)
+    {
+        stack = calloc_wrapper(1, sizeof(OperandStack));
+        pthread_setspecific(operand_stack_key, stack);
+    }
+    return stack;
+}
+
+/*
+Summary: Computes number of operands that are on stack at most while tree is reduced.
+    Child i of an operator is reduced while the values of its i preceding siblings are on stack.
+*/
+size_t tree_reduce_stack_size(const Node *tree)
+{
+    if (get_type(tree) != NTYPE_OPERATOR) return 1;
+
+    size_t res = get_num_children(tree) > 0 ? get_num_children(tree) : 1;
+    for (size_t i = 0; i < get_num_children(tree); i++)
+    {
+        size_t child_size = i + tree_reduce_stack_size(get_child(tree, i));
+        if (child_size > res) res = child_size;
+    }
+    return res;
+}
+
+// Reduces tree and places result at stack[0], values of children of an operator are placed next to each other
+static ListenerError reduce_on_stack(const Node *tree, TreeListener listener, double *stack, const Node **out_errnode)
 {
     switch (get_type(tree))
     {
         case NTYPE_CONSTANT:
-            *out = get_const_value(tree);
+            stack[0] = get_const_value(tree);
             return LISTENERERR_SUCCESS;
 
         case NTYPE_OPERATOR:
         {
             size_t num_args = get_num_children(tree);
-            double *args = malloc_wrapper(sizeof(double) * num_args);
-
-            for (size_t i = LISTENERERR_SUCCESS; i < num_args; i++)
+            for (size_t i = 0; i < num_args; i++)
             {
-                ListenerError err = tree_reduce(get_child(tree, i), listener, &args[i], out_errnode);
-                if (err != LISTENERERR_SUCCESS)
-                {
-                    free(args);
-                    return err;
-                }
+                ListenerError err = reduce_on_stack(get_child(tree, i), listener, stack + i, out_errnode);
+                if (err != LISTENERERR_SUCCESS) return err;
             }
 
-            ListenerError err = listener(get_op(tree), num_args, args, out);
+            double res;
+            ListenerError err = listener(get_op(tree), num_args, stack, &res);
             if (err != LISTENERERR_SUCCESS)
             {
                 if (out_errnode != NULL) *out_errnode = tree;
-                free(args);
                 return err;
             }
-
-            free(args);
+            stack[0] = res;
             return LISTENERERR_SUCCESS;
         }
 
@@ -413,34 +479,99 @@ ListenerError tree_reduce(const Node *tree, TreeListener listener, double *out,
     }
 }
 
+/*
+Summary: Like tree_reduce, but operands are placed on a stack provided by the caller. Does not allocate.
+Params
+    stack: Buffer of at least tree_reduce_stack_size(tree) doubles
+*/
+ListenerError tree_reduce_on_stack(const Node *tree,
+    TreeListener listener,
+    double *stack,
+    double *out,
+    const Node **out_errnode)
+{
+    ListenerError err = reduce_on_stack(tree, listener, stack, out_errnode);
+    if (err == LISTENERERR_SUCCESS) *out = stack[0];
+    return err;
+}
+
+/*
+Summary: Evaluates operator tree. Operands are placed on a stack that is reused by all evaluations of the thread,
+    so only an evaluation of a larger tree than before allocates.
+Returns: True if reduction could be applied, i.e. no variable in tree and reduction-function did not return false
+Params
+    tree:      Tree to reduce to a constant
+    reduction: Function that takes an operator, number of children, and pointer to number of children many child values
+    out:       Reduction result
+*/
+ListenerError tree_reduce(const Node *tree, TreeListener listener, double *out, const Node **out_errnode)
+{
+    if (get_type(tree) == NTYPE_CONSTANT)
+    {
+        *out = get_const_value(tree);
+        return LISTENERERR_SUCCESS;
+    }
+
+    OperandStack *stack = get_operand_stack();
+    size_t size = tree_reduce_stack_size(tree);
+    if (stack->in_use)
+    {
+        double *values = malloc_wrapper(size * sizeof(double));
+        ListenerError err = tree_reduce_on_stack(tree, listener, values, out, out_errnode);
+        free(values);
+        return err;
+    }
+
+    if (stack->capacity < size)
+    {
+        stack->values = realloc_wrapper(stack->values, size * sizeof(double));
+        stack->capacity = size;
+    }
+    stack->in_use = true;
+    ListenerError err = tree_reduce_on_stack(tree, listener, stack->values, out, out_errnode);
+    stack->in_use = false;
+    return err;
+}
+
 /*
 Summary: Replaces reducible subtrees by a ConstantNode
+    Single bottom-up pass: Children are reduced first, an operator is reduced iff all of its children became constant.
+    Thus, only maximal constant subtrees are replaced, each operator is evaluated once.
 Params:
     tree:            Tree that will be changed
-    listener:        Compositional evaluation function
+    listener:        Compositional evaluation function. Returns LISTENERERR_VARIABLE_ENCOUNTERED to keep an operator
 */
 ListenerError tree_reduce_constant_subtrees(Node **tree, TreeListener listener, const Node **out_errnode)
 {
-    if (count_all_variable_nodes(*tree) == 0)
+    if (get_type(*tree) != NTYPE_OPERATOR) return LISTENERERR_SUCCESS;
+
+    size_t num_children = get_num_children(*tree);
+    bool is_constant = true;
+    for (size_t i = 0; i < num_children; i++)
     {
-        double res;
-        ListenerError err = tree_reduce(*tree, listener, &res, out_errnode);
+        ListenerError err = tree_reduce_constant_subtrees(get_child_addr(*tree, i), listener, out_errnode);
         if (err != LISTENERERR_SUCCESS) return err;
-        Node *replacement = malloc_constant_node(res, get_token_index(*tree));
-        tree_replace(tree, replacement);
+        if (get_type(get_child(*tree, i)) != NTYPE_CONSTANT) is_constant = false;
     }
-    else
+    if (!is_constant) return LISTENERERR_SUCCESS;
+
+    double inline_args[REDUCE_INLINE_ARGS];
+    double *args = num_children <= REDUCE_INLINE_ARGS ? inline_args : malloc_wrapper(num_children * sizeof(double));
+    for (size_t i = 0; i < num_children; i++)
     {
-        if (get_type(*tree) == NTYPE_OPERATOR)
-        {
-            for (size_t i = 0; i < get_num_children(*tree); i++)
-            {
-                ListenerError err = tree_reduce_constant_subtrees(get_child_addr(*tree, i), listener, out_errnode);
-                if (err != LISTENERERR_SUCCESS) return err;
-            }
-        }
+        args[i] = get_const_value(get_child(*tree, i));
     }
+    double res;
+    ListenerError err = listener(get_op(*tree), num_children, args, &res);
+    if (args != inline_args) free(args);
 
+    if (err == LISTENERERR_VARIABLE_ENCOUNTERED) return LISTENERERR_SUCCESS;
+    if (err != LISTENERERR_SUCCESS)
+    {
+        if (out_errnode != NULL) *out_errnode = *tree;
+        return err;
+    }
+    tree_replace(tree, malloc_constant_node(res, get_token_index(*tree)));
     return LISTENERERR_SUCCESS;
 }
 
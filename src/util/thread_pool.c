@@ -0,0 +1,193 @@
+#include "alloc_wrappers.h"
+#include "thread_pool.h"
+
+// Returns: True if index of argument could be taken from bottom of own queue
+static bool pop_bottom(TaskQueue *queue, size_t *out_index)
+{
+    bool res = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->top < queue->bottom)
+    {
+        *out_index = --queue->bottom;
+        res = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return res;
+}
+
+// Returns: True if index of argument could be taken from top of other queue
+static bool steal_top(TaskQueue *queue, size_t *out_index)
+{
+    bool res = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->top < queue->bottom)
+    {
+        *out_index = queue->top++;
+        res = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return res;
+}
+
+// Processes own tasks, then steals from other threads until all queues are empty
+static void process_tasks(ThreadPool *pool, size_t index)
+{
+    while (true)
+    {
+        size_t arg_index;
+        bool found = pop_bottom(&pool->queues[index], &arg_index);
+        for (size_t i = 1; i < pool->num_threads && !found; i++)
+        {
+            found = steal_top(&pool->queues[(index + i) % pool->num_threads], &arg_index);
+        }
+        // Tasks don't spawn new tasks, so we are done
+        if (!found) return;
+
+        pool->task(pool->args[arg_index]);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *worker = (Worker*)arg;
+    ThreadPool *pool = worker->pool;
+    size_t last_generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true)
+    {
+        while (!pool->shutdown && pool->generation == last_generation)
+        {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->shutdown) break;
+        last_generation = pool->generation;
+        void *state = pool->state;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (pool->adopt != NULL) pool->adopt(state);
+        process_tasks(pool, worker->index);
+        if (pool->adopt != NULL) pool->adopt(NULL);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->num_busy--;
+        if (pool->num_busy == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*
+Summary: Starts num_threads - 1 worker threads, the thread calling pool_run is used as well
+*/
+ThreadPool *pool_create(size_t num_threads)
+{
+    if (num_threads == 0) num_threads = 1;
+
+    ThreadPool *pool = malloc_wrapper(sizeof(ThreadPool));
+    *pool = (ThreadPool){
+        .num_threads = num_threads,
+        .threads     = malloc_wrapper((num_threads - 1) * sizeof(pthread_t)),
+        .workers     = malloc_wrapper(num_threads * sizeof(Worker)),
+        .queues      = malloc_wrapper(num_threads * sizeof(TaskQueue)),
+        .generation  = 0,
+        .num_busy    = 0,
+        .shutdown    = false,
+        .capture     = NULL,
+        .adopt       = NULL,
+        .state       = NULL
+    };
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+        pool->queues[i].top = 0;
+        pool->queues[i].bottom = 0;
+        pool->workers[i] = (Worker){ .pool = pool, .index = i };
+    }
+    for (size_t i = 1; i < num_threads; i++)
+    {
+        pthread_create(&pool->threads[i - 1], NULL, worker_main, &pool->workers[i]);
+    }
+    return pool;
+}
+
+void pool_destroy(ThreadPool *pool)
+{
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 1; i < pool->num_threads; i++)
+    {
+        pthread_join(pool->threads[i - 1], NULL);
+    }
+
+    for (size_t i = 0; i < pool->num_threads; i++)
+    {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_mutex_destroy(&pool->run_lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->queues);
+    free(pool);
+}
+
+size_t pool_num_threads(const ThreadPool *pool)
+{
+    return pool->num_threads;
+}
+
+/*
+Summary: Sets hooks that let workers adopt state of the caller of pool_run before they call tasks.
+    Must not be called while the pool runs
+*/
+void pool_set_hooks(ThreadPool *pool, CaptureHook capture, AdoptHook adopt)
+{
+    pool->capture = capture;
+    pool->adopt = adopt;
+}
+
+/*
+Summary: Calls task for each argument and returns when all calls returned.
+    Arguments are distributed evenly, threads that are done steal arguments of other threads.
+    When called by several threads concurrently, the runs are executed one after another.
+*/
+void pool_run(ThreadPool *pool, Task task, size_t num_args, void **args)
+{
+    pthread_mutex_lock(&pool->run_lock);
+    for (size_t i = 0; i < pool->num_threads; i++)
+    {
+        pool->queues[i].top = i * num_args / pool->num_threads;
+        pool->queues[i].bottom = (i + 1) * num_args / pool->num_threads;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->args = args;
+    pool->state = pool->capture != NULL ? pool->capture() : NULL;
+    pool->num_busy = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    process_tasks(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->num_busy > 0)
+    {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+}
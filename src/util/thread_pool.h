@@ -0,0 +1,52 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef void (*Task)(void *arg);
+// Let workers adopt thread-local state of the thread that calls pool_run, e.g. the session evaluation depends on
+typedef void *(*CaptureHook)();
+typedef void (*AdoptHook)(void *state); // Called with NULL when a run is finished
+
+// Tasks of a thread, others steal from top while owner pops from bottom
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t top;
+    size_t bottom;
+} TaskQueue;
+
+typedef struct ThreadPool ThreadPool;
+
+// Passed to each worker thread
+typedef struct
+{
+    ThreadPool *pool;
+    size_t index;
+} Worker;
+
+struct ThreadPool
+{
+    size_t num_threads;  // Including the thread that calls pool_run
+    pthread_t *threads;  // num_threads - 1 workers
+    Worker *workers;
+    TaskQueue *queues;   // One per thread, first one belongs to calling thread
+    pthread_mutex_t run_lock; // Serializes runs of concurrent callers
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    size_t generation;   // Incremented for each run
+    size_t num_busy;     // Workers that have not finished current run
+    bool shutdown;
+    Task task;
+    void **args;
+    CaptureHook capture;  // Is allowed to be NULL
+    AdoptHook adopt;      // Is allowed to be NULL
+    void *state;          // Captured from caller of current run
+};
+
+ThreadPool *pool_create(size_t num_threads);
+void pool_destroy(ThreadPool *pool);
+size_t pool_num_threads(const ThreadPool *pool);
+void pool_set_hooks(ThreadPool *pool, CaptureHook capture, AdoptHook adopt);
+void pool_run(ThreadPool *pool, Task task, size_t num_args, void **args);
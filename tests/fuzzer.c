@@ -53,7 +53,9 @@ void get_random_tree(size_t max_inner_nodes, Node **out)
 
         for (size_t i = 0; i < num_children; i++)
         {
-            get_random_tree(rand() % (1 + max_inner_nodes / num_children), get_child_addr(*out, i));
+            Node *child = NULL;
+            get_random_tree(rand() % (1 + max_inner_nodes / num_children), &child);
+            set_child(*out, i, child);
         }
     }
 }
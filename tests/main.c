@@ -10,6 +10,7 @@
 #include "test.h"
 #include "test_tree_util.h"
 #include "test_parser.h"
+#include "test_evaluation.h"
 #include "test_tree_to_string.h"
 #include "test_randomized.h"
 #include "test_table.h"
@@ -24,10 +25,11 @@ Please check with valgrind when all tests pass
 Memory leaks are intentionally present when tests fail (for brevity)
 */
 
-static const size_t NUM_TESTS = 7;
+static const size_t NUM_TESTS = 8;
 static Test (*test_getters[])() = {
     get_tree_util_test,
     get_parser_test,
+    get_evaluation_test,
     get_tree_to_string_test,
     get_randomized_test,
     get_table_test,
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../src/engine/parsing/parser.h"
+#include "../src/engine/tree/tree_util.h"
+#include "../src/client/core/arith_context.h"
+#include "../src/client/core/arith_evaluation.h"
+#include "../src/client/core/batch_evaluation.h"
+#include "../src/client/core/compensated_evaluation.h"
+#include "../src/client/core/interval_evaluation.h"
+#include "../src/client/core/dual_evaluation.h"
+#include "../src/client/core/session.h"
+#include "../src/util/thread_pool.h"
+#include "test_evaluation.h"
+
+static const double EPSILON = 0.00000001;
+
+// Compares batch evaluation of expression with x and y over many rows with evaluation of each row on its own
+static bool check_batch(const ParsingContext *ctx, const char *input, StringBuilder *error_builder)
+{
+    const size_t num_rows = 600; // More than one block
+    const char *vars[] = { "x", "y" };
+    double *x = malloc(num_rows * sizeof(double));
+    double *y = malloc(num_rows * sizeof(double));
+    double *results = malloc(num_rows * sizeof(double));
+    ListenerError *errors = malloc(num_rows * sizeof(ListenerError));
+    for (size_t i = 0; i < num_rows; i++)
+    {
+        x[i] = (double)i / 7 - 20;
+        y[i] = (double)(i % 13) - 6;
+    }
+
+    Node *node = parse_easy(ctx, input);
+    BatchProgram program;
+    bool compiled = batch_compile(node, 2, vars, &program);
+    if (compiled)
+    {
+        batch_evaluate(&program, num_rows, (const double*[]){ x, y }, results, errors);
+        batch_free(&program);
+    }
+
+    bool is_equal = compiled;
+    for (size_t i = 0; i < num_rows && is_equal; i++)
+    {
+        Node *row = tree_copy(node);
+        Node *x_node = malloc_constant_node(x[i], 0);
+        Node *y_node = malloc_constant_node(y[i], 0);
+        replace_variable_nodes(&row, x_node, "x");
+        replace_variable_nodes(&row, y_node, "y");
+        double expected = 0;
+        ListenerError err = tree_reduce(row, arith_op_evaluate, &expected, NULL);
+        is_equal = err == errors[i]
+            && (err != LISTENERERR_SUCCESS || expected == results[i] || (isnan(expected) && isnan(results[i])));
+        free_tree(row);
+        free_tree(x_node);
+        free_tree(y_node);
+    }
+
+    free_tree(node);
+    free(x);
+    free(y);
+    free(results);
+    free(errors);
+    if (!is_equal)
+    {
+        ERROR("Batch evaluation of '%s' differs from evaluation of single rows\n", input);
+    }
+    return true;
+}
+
+// Compensated evaluation is exact for sums of few doubles, where double evaluation suffers from cancellation
+static bool check_compensated(ParsingContext *ctx, StringBuilder *error_builder)
+{
+    Node *exact = parse_easy(ctx, "sum(0.1, 0.2, -0.3) + (10^16 + 1 - 10^16) * 2");
+    DoubleDouble res;
+    ListenerError err = dd_evaluate(exact, 0, NULL, NULL, &res, NULL);
+    free_tree(exact);
+    // 0.1 + 0.2 - 0.3 of the nearest doubles is 2^-55
+    if (err != LISTENERERR_SUCCESS || dd_to_double(res) != 2 + ldexp(1, -55))
+    {
+        ERROR("Unexpected result of compensated evaluation\n");
+    }
+
+    // Only constant subtrees are reduced, variables are bound by dd_evaluate
+    Node *mixed = parse_easy(ctx, "x + (0.1 + 0.2 - 0.3) / 2");
+    if (dd_reduce_constant_subtrees(&mixed, true, NULL) != LISTENERERR_SUCCESS
+        || get_type(get_child(mixed, 1)) != NTYPE_CONSTANT
+        || get_const_value(get_child(mixed, 1)) != ldexp(1, -56))
+    {
+        free_tree(mixed);
+        ERROR("Unexpected result of compensated reduction\n");
+    }
+    DoubleDouble acc = dd_from_double(1e16);
+    for (size_t i = 0; i < 4; i++)
+    {
+        err = dd_evaluate(mixed, 1, (const char*[]){ "x" }, &acc, &acc, NULL);
+    }
+    free_tree(mixed);
+    if (err != LISTENERERR_SUCCESS || acc.hi != 1e16 || acc.lo != ldexp(1, -54))
+    {
+        ERROR("Unexpected result of compensated accumulation\n");
+    }
+    return true;
+}
+
+static bool check_intervals(ParsingContext *ctx, StringBuilder *error_builder)
+{
+    struct
+    {
+        const char *expr;
+        Interval value;
+        ListenerError error;
+        bool certain;
+        Interval expected; // Must be contained in result, which must not be wider than limit
+        Interval limit;
+    } cases[] = {
+        { "x^2-x",        { -1, 2 },  LISTENERERR_SUCCESS,          false, { -0.25, 2 }, { -2.1, 5.1 } },
+        { "sin(x)",       { 1, 2 },   LISTENERERR_SUCCESS,          false, { sin(1), 1 }, { sin(1) - 1e-9, 1 } },
+        { "exp(x)/x",     { 1, 2 },   LISTENERERR_SUCCESS,          false, { exp(1), exp(2) / 2 }, { 1.3, 7.4 } },
+        { "1/x",          { -1, 1 },  LISTENERERR_DIVISION_BY_ZERO, false, { 0, 0 }, { 0, 0 } },
+        { "sqrt(x)",      { -2, -1 }, LISTENERERR_COMPLEX_SOLUTION, true,  { 0, 0 }, { 0, 0 } },
+        { "x + sqrt(-1)", { 0, 1 },   LISTENERERR_COMPLEX_SOLUTION, true,  { 0, 0 }, { 0, 0 } },
+        { "rand(0, 10) + x", { 0, 1 }, LISTENERERR_SUCCESS,       false, { 0, 10 }, { -1, 11 } }
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++)
+    {
+        Node *tree = parse_easy(ctx, cases[i].expr);
+        Interval res;
+        bool certain = false;
+        ListenerError err = interval_evaluate(tree, "x", cases[i].value, &res, &certain);
+        free_tree(tree);
+
+        if (err != cases[i].error || (err != LISTENERERR_SUCCESS && certain != cases[i].certain))
+        {
+            ERROR("Unexpected error of interval evaluation of '%s'\n", cases[i].expr);
+        }
+        if (err == LISTENERERR_SUCCESS
+            && (res.lo > cases[i].expected.lo || res.hi < cases[i].expected.hi
+                || res.lo < cases[i].limit.lo || res.hi > cases[i].limit.hi))
+        {
+            ERROR("Unexpected bounds [%g, %g] of '%s'\n", res.lo, res.hi, cases[i].expr);
+        }
+    }
+    return true;
+}
+
+static bool check_derivatives(ParsingContext *ctx, StringBuilder *error_builder)
+{
+    // Derivatives at x = 0.5 compared with their closed form
+    const double x = 0.5;
+    struct
+    {
+        const char *expr;
+        double expected;
+        ListenerError error;
+    } cases[] = {
+        { "deriv(sin(x)*x^2, x)",          cos(x) * x * x + 2 * x * sin(x), LISTENERERR_SUCCESS },
+        { "(x^3/(1+x))'",                  (2 * x * x * x + 3 * x * x) / ((1 + x) * (1 + x)), LISTENERERR_SUCCESS },
+        { "deriv(prod(x, x, 2^x), x)",     pow(2, x) * x * (2 + x * log(2)), LISTENERERR_SUCCESS },
+        { "deriv(max(x, 1/4) + ln(x), x)", 1 + 1 / x, LISTENERERR_SUCCESS },
+        { "deriv(x, y) + 1",               1, LISTENERERR_SUCCESS },
+        { "deriv(fib(x), x)",              0, LISTENERERR_IMPOSSIBLE_DERIV },
+        { "deriv(deriv(x^3, x), x)",       0, LISTENERERR_IMPOSSIBLE_DERIV }
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); i++)
+    {
+        Node *tree = parse_easy(ctx, cases[i].expr);
+        Dual res;
+        ListenerError err = dual_evaluate(tree, 1, (const char*[]){ "x" }, &x, NULL, &res, NULL);
+        free_tree(tree);
+        if (err != cases[i].error || (err == LISTENERERR_SUCCESS && fabs(res.value - cases[i].expected) > EPSILON))
+        {
+            ERROR("Unexpected numeric derivative of '%s'\n", cases[i].expr);
+        }
+    }
+    return true;
+}
+
+#define SESSION_EVALUATIONS 200
+
+struct SessionTask
+{
+    const Node *tree;
+    Session *session;
+    double results[SESSION_EVALUATIONS];
+    ListenerError error;
+};
+
+// Each result is added to history of session, on which next evaluation depends
+static void session_task(void *arg)
+{
+    struct SessionTask *task = (struct SessionTask*)arg;
+    for (size_t i = 0; i < SESSION_EVALUATIONS && task->error == LISTENERERR_SUCCESS; i++)
+    {
+        task->error = session_evaluate(task->session, task->tree, task->results + i);
+        session_history_add(task->session, task->results[i]);
+    }
+}
+
+// Sessions that are evaluated concurrently must give the same results as when evaluated one after another
+static bool check_sessions(ParsingContext *ctx, StringBuilder *error_builder)
+{
+    const size_t num_tasks = 8;
+    Node *tree = parse_easy(ctx, "rand(0, 1000) + ans mod 7");
+    struct SessionTask *tasks = malloc(2 * num_tasks * sizeof(struct SessionTask));
+    void **args = malloc(num_tasks * sizeof(void*));
+    for (size_t i = 0; i < 2 * num_tasks; i++)
+    {
+        Session *session = session_create(i % num_tasks);
+        session_history_add(session, 0);
+        tasks[i] = (struct SessionTask){ .tree = tree, .session = session, .error = LISTENERERR_SUCCESS };
+        if (i < num_tasks) args[i] = tasks + i;
+    }
+
+    ThreadPool *pool = pool_create(4);
+    pool_run(pool, session_task, num_tasks, args);
+    pool_destroy(pool);
+
+    bool is_equal = true;
+    for (size_t i = num_tasks; i < 2 * num_tasks; i++)
+    {
+        session_task(tasks + i);
+        is_equal &= tasks[i].error == LISTENERERR_SUCCESS && tasks[i - num_tasks].error == LISTENERERR_SUCCESS
+            && memcmp(tasks[i].results, tasks[i - num_tasks].results, sizeof(tasks[i].results)) == 0;
+    }
+
+    // Numbers below bound are drawn uniformly
+    size_t counts[6] = { 0 };
+    for (size_t i = 0; i < 6000; i++)
+    {
+        uint64_t value = session_random_below(tasks[0].session, 6);
+        if (value < 6) counts[value]++;
+    }
+    for (size_t i = 0; i < 6; i++) is_equal &= counts[i] > 800 && counts[i] < 1200;
+
+    for (size_t i = 0; i < 2 * num_tasks; i++) session_free(tasks[i].session);
+    free(tasks);
+    free(args);
+    free_tree(tree);
+    if (!is_equal)
+    {
+        ERROR("Concurrent evaluation of sessions differs from sequential one or random numbers are biased\n");
+    }
+    return true;
+}
+
+bool evaluation_test(StringBuilder *error_builder)
+{
+    ParsingContext ctx = get_arith_ctx();
+
+    // Perform batch tests
+    const char *batchTests[] = {
+        "x/y + sqrt(x) - max(x, y, 3) * min(y)",
+        "sum(x, y, 2)% + prod(x, -y) / avg(x, y)",
+        "frac(abs(x)) + floor(y/3) - ceil(x) + trunc(x y) + sin(x)^2",
+        "ln(x) + fib(y) + x!",
+        "var(x, y, 1, x y) + sum(x, 2, y, 3, x, 4, y, 5, x)",
+        "x^y + root(x, y) - log(x, y) + exp(sgn(y)) * tanh(round(x))",
+        "(1/y)^x + x^(y/2) - y^(x/3)",
+        "(x^2 + sin(x)) / y + (x^2 + sin(x)) * (sqrt(y) + x^2)"
+    };
+    for (size_t i = 0; i < sizeof(batchTests) / sizeof(*batchTests); i++)
+    {
+        if (!check_batch(&ctx, batchTests[i], error_builder)) return false;
+    }
+
+    // Repeated subexpressions are computed once and stored, impure ones are evaluated for each occurrence
+    struct
+    {
+        const char *input;
+        size_t num_instructions;
+    } cseTests[] = {
+        { "(x^2 + sin(x)) * (x^2 + sin(x)) + x^2", 12 }, // x 2 ^ store x sin + store load * load +
+        { "rand(1, 9) + rand(1, 9)",               7 }
+    };
+    for (size_t i = 0; i < 2; i++)
+    {
+        const char *vars[] = { "x" };
+        BatchProgram program;
+        Node *tree = parse_easy(&ctx, cseTests[i].input);
+        batch_compile(tree, 1, vars, &program);
+        bool is_equal = vec_count(&program.instructions) == cseTests[i].num_instructions;
+        batch_free(&program);
+        free_tree(tree);
+        if (!is_equal)
+        {
+            ERROR("Unexpected number of instructions of '%s'\n", cseTests[i].input);
+        }
+    }
+
+    if (!check_compensated(&ctx, error_builder)) return false;
+    if (!check_intervals(&ctx, error_builder)) return false;
+    if (!check_derivatives(&ctx, error_builder)) return false;
+    if (!check_sessions(&ctx, error_builder)) return false;
+
+    ctx_destroy(&ctx);
+    return true;
+}
+
+Test get_evaluation_test()
+{
+    return (Test){
+        evaluation_test,
+        "Evaluation"
+    };
+}
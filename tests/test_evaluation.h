@@ -0,0 +1,3 @@
+#include "test.h"
+
+Test get_evaluation_test();
@@ -20,7 +20,7 @@ struct ErrorTest {
     ParserError result;
 };
 
-static const size_t NUM_VALUE_CASES = 43;
+static const size_t NUM_VALUE_CASES = 63;
 static struct ValueTest valueTests[] = {
     // 1. Basic prefix, infix, postfix
     { "2+3",         5 },
@@ -36,8 +36,21 @@ static struct ValueTest valueTests[] = {
     // 2. Correct implementation of evaluation (ToDo: extend)
     { "fib(7)",         13 },
     { "fib(-8)",       -21 },
+    { "fib(90)",         2880067194370816120.0 },
+    { "20!",             2432902008176640000.0 },
+    { "3.5!",           11.631728396567 },
+    { "52 C 5",    2598960 },
+    { "3 C 5",           0 },
+    { "100 C 99",      100 },
+    { "10^6 C 2",   499999500000 },
     { "gcd(942, 492)",   6 },
     { "lcm(14, 24)",   168 },
+    { "gcd(10^15, 1)",   1 },
+    { "gcd(3*2^40, 9*2^20)",      3145728 },
+    { "lcm(10^9, 10^9+1)",        1000000001000000000.0 },
+    { "(2^53-1) mod 10",          1 },
+    { "(-7) mod 3",              -1 },
+    { "60 C 30",                  118264581564861424.0 },
     // 3. Precedence and parentheses
     { "1+2*3+4",      11 },
     { "1+2*(3+4)",    15 },
@@ -70,6 +83,13 @@ static struct ValueTest valueTests[] = {
     { "sum(1,2,3)",                  6 },
     { "prod(2,3,4)-4!",              0 },
     { "sum(sum(1,2),sum(3,4),5)+6", 21 },
+    { "max(3, 7, 1, 9, 2, -4)",      9 },
+    { "min(3, 7, 1, 9, 2, -4)",     -4 },
+    { "avg(1, 2, 3, 4, 5, 6)",       3.5 },
+    { "prod(1, 2, 3, 4, 5, 6)",    720 },
+    { "prod(10^200, 10^200, 10^-200, 10^-200, 3)", INFINITY },
+    { "var(1, 2, 3, 4)",             1.25 },
+    { "var(10^9+4, 10^9+7, 10^9+13, 10^9+16, 10^9+4)", 23.76 },
     // 6. Going wild
     { "5 .5sin(2)+5pi5", 80.81305990681 },
     { "--(1+sum(ld(--8), --1%+--1%, 2 .2))%+1", 1.0442 },
@@ -107,13 +127,28 @@ static struct ErrorTest errorTests[] = {
 static const double EPSILON = 0.00000001;
 bool almost_equals(double a, double b)
 {
-    return (fabs(a - b) < EPSILON);
+    return a == b || fabs(a - b) < EPSILON;
 }
 
 bool parser_test(StringBuilder *error_builder)
 {
     ParsingContext ctx = get_arith_ctx();
 
+    // Check that descriptors of built-in operators match their ids
+    if (ctx_lookup_op(&ctx, "sin", OP_PLACE_FUNCTION)->id != ARITH_OP_SIN
+        || ctx_lookup_op(&ctx, "-", OP_PLACE_PREFIX)->id != ARITH_OP_NEG
+        || ctx_lookup_op(&ctx, "ans", OP_PLACE_FUNCTION)->id != ARITH_OP_ANS)
+    {
+        ERROR("Operator ids differ from ArithOpId\n");
+    }
+    if (!ctx_lookup_op(&ctx, "^", OP_PLACE_INFIX)->pure
+        || ctx_lookup_op(&ctx, "rand", OP_PLACE_FUNCTION)->pure
+        || op_get_arity_class(ctx_lookup_op(&ctx, "sum", OP_PLACE_FUNCTION)) != OP_ARITY_DYNAMIC
+        || op_get_arity_class(ctx_lookup_op(&ctx, "pi", OP_PLACE_FUNCTION)) != OP_ARITY_CONSTANT)
+    {
+        ERROR("Unexpected flags of built-in operators\n");
+    }
+
     // Perform value tests
     for (size_t i = 0; i < NUM_VALUE_CASES; i++)
     {
@@ -132,6 +167,28 @@ bool parser_test(StringBuilder *error_builder)
         }
     }
 
+    // Perform folding tests, second expression is parsed without folding
+    const char *foldingTests[][2] = {
+        { "2*3+x",         "6+x" },
+        { "x+2*3",         "x+6" },
+        { "sum(1, 2, 3)x", "6x" },
+        { "rand(1, 2)+1",  "rand(1, 2)+1" },
+        { "1/0+x",         "1/0+x" },
+        { "(2+3)'",        "5'" }
+    };
+    for (size_t i = 0; i < 6; i++)
+    {
+        ParsingResult res;
+        Node *expected = parse_easy(&ctx, foldingTests[i][1]);
+        bool is_equal = parse_input_folded(&ctx, foldingTests[i][0], &res) && tree_equals(res.tree, expected);
+        free_result(&res, true);
+        free_tree(expected);
+        if (!is_equal)
+        {
+            ERROR("Unexpected folding of '%s'\n", foldingTests[i][0]);
+        }
+    }
+
     // Perform error tests
     // Remove glue-op to test for "expected infix or prefix"
     ctx_set_glue_op(&ctx, NULL);
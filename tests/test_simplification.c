@@ -1,14 +1,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #include "../src/engine/tree/operator.h"
 #include "../src/engine/tree/tree_util.h"
 #include "../src/engine/tree/tree_to_string.h"
 #include "../src/engine/parsing/parser.h"
+#include "../src/engine/transformation/rule_parsing.h"
 #include "../src/client/core/arith_context.h"
 #include "../src/client/core/arith_evaluation.h"
+#include "../src/client/core/compensated_evaluation.h"
+#include "../src/client/core/interval_evaluation.h"
 #include "../src/client/simplification/simplification.h"
+#include "../src/client/commands/cmd_table.h"
+#include "../src/util/thread_pool.h"
 #include "test_simplification.h"
 
 static const size_t NUM_CASES = 23;
@@ -40,14 +46,20 @@ const char *cases[] = {
     "(x+y-y)'",            "1",
 };
 
-bool simplification_test(StringBuilder *error_builder)
-{
-    if (!simplification_is_initialized())
-    {
-        ERROR("Simplification module initialization failed\n");
-    }
+// Cases for simplification by equality saturation
+static const size_t NUM_EGRAPH_CASES = 6;
+const char *egraph_cases[] = {
+    "x-x",                 "0",
+    "x+x+x+x+x",           "5x",
+    "(-x)^2 - x^2",        "0",
+    "(2x)/(4x)",           "0.5",
+    "5x-6x",               "-x",
+    "deriv(3*x*y, y)",     "3x",
+};
 
-    for (size_t i = 0; i < NUM_CASES; i++)
+static bool check_cases(size_t num_cases, const char **cases, StringBuilder *error_builder)
+{
+    for (size_t i = 0; i < num_cases; i++)
     {
         Node *left = parse_easy(g_ctx, cases[2 * i]);
         if (left == NULL)
@@ -81,10 +93,240 @@ bool simplification_test(StringBuilder *error_builder)
                 free(right_result);
             }
         }
-        
+    
         free_tree(left);
         free_tree(right);
     }
+    return true;
+}
+
+// Rule with more variables than fit into a matching inline, bindings of higher ids are stored on heap
+static bool check_wide_rule(StringBuilder *error_builder)
+{
+    RewriteRule rule;
+    if (!parse_rule("sum(a,b,c,d,f,g,h,j,k,m,n,[l],o) -> sum(o,[l],n,a)", g_ctx, &rule))
+    {
+        ERROR("Could not parse rule with 13 variables.\n");
+    }
+    Node *tree = parse_easy(g_ctx, "2*sum(1,2,3,4,5,6,7,8,9,10,11,12,13,14)");
+    Node *expected = parse_easy(g_ctx, "2*sum(14,12,13,11,1)");
+
+    bool applied = apply_rule(&tree, &rule, NULL);
+    bool equal = tree_equals(tree, expected);
+    free_rule(&rule);
+    free_tree(tree);
+    free_tree(expected);
+    if (!applied || !equal)
+    {
+        ERROR("Rule with 13 variables was not applied correctly.\n");
+    }
+    return true;
+}
+
+// Ruleset that never terminates and alternates between y and y*1, smaller tree has to be kept when stopped
+static bool check_budget(StringBuilder *error_builder)
+{
+    Vector ruleset = get_empty_ruleset();
+    const char *rules[] = { "x*1 -> x", "x -> x*1" };
+    for (size_t i = 0; i < 2; i++)
+    {
+        RewriteRule rule;
+        if (!parse_rule(rules[i], g_ctx, &rule))
+        {
+            free_ruleset(&ruleset);
+            ERROR("Could not parse rule %s.\n", rules[i]);
+        }
+        add_to_ruleset(&ruleset, rule);
+    }
+
+    Node *tree = parse_easy(g_ctx, "y");
+    Node *expected = parse_easy(g_ctx, "y");
+    size_t steps = apply_ruleset(&tree, &ruleset, STRATEGY_TOP_DOWN, NULL, NULL, NULL, get_budget(101, 0));
+    bool stepped_correctly = steps == 101 && tree_equals(tree, expected);
+    apply_ruleset(&tree, &ruleset, STRATEGY_TOP_DOWN, NULL, NULL, NULL, get_budget(SIZE_MAX, 10));
+    bool stopped_in_time = tree_equals(tree, expected);
+
+    free_ruleset(&ruleset);
+    free_tree(tree);
+    free_tree(expected);
+    if (!stepped_correctly)
+    {
+        ERROR("Step budget of non-terminating ruleset not met or best tree not kept.\n");
+    }
+    if (!stopped_in_time)
+    {
+        ERROR("Time budget of non-terminating ruleset not met or best tree not kept.\n");
+    }
+    return true;
+}
+
+// Numeric derivatives of tables that are nested fall back to symbolic ones
+static bool check_table_derivatives(StringBuilder *error_builder)
+{
+    const char *inputs[] = { "(x^3)''", "deriv(deriv(x^3, x), x)", "deriv(sin(x) x, x)" };
+    const double x[] = { 1, 2, 3 };
+    Vector values = vec_create(sizeof(double), 3);
+    vec_push_many(&values, 3, (void*)x);
+
+    bool is_equal = true;
+    for (size_t i = 0; i < 3 && is_equal; i++)
+    {
+        char input[32];
+        strcpy(input, inputs[i]);
+        ParsingResult presult;
+        double results[3];
+        ListenerError errors[3];
+        is_equal = arith_parse_raw(input, 0, &presult);
+        Node *expr = is_equal ? arith_simplify_numeric_derivatives(&presult, 0) : NULL;
+        is_equal = expr != NULL && table_evaluate(input, 0, &expr, "x", &values, results, errors);
+        for (size_t j = 0; j < 3 && is_equal; j++)
+        {
+            double expected = i < 2 ? 6 * x[j] : cos(x[j]) * x[j] + sin(x[j]);
+            is_equal = errors[j] == LISTENERERR_SUCCESS && fabs(results[j] - expected) < 1e-9;
+        }
+        free_tree(expr);
+        if (!is_equal)
+        {
+            vec_destroy(&values);
+            ERROR("Unexpected table of '%s'\n", inputs[i]);
+        }
+    }
+    vec_destroy(&values);
+    return true;
+}
+
+// Bounds of an expression need all possible random numbers, so rand must not be folded to a single draw
+static bool check_keeping_random(StringBuilder *error_builder)
+{
+    for (size_t compensated = 0; compensated < 2; compensated++)
+    {
+        set_compensated_evaluation(compensated);
+        char input[] = "rand(0, 10) + 2 * 3 x";
+        ParsingResult presult;
+        Node *expr = arith_parse_raw(input, 0, &presult) ? arith_simplify_keeping_random(&presult, 0) : NULL;
+        Interval bounds = { 0, 0 };
+        bool certain = false;
+        bool is_equal = expr != NULL
+            && find_op((const Node**)&expr, ctx_lookup_op(g_ctx, "rand", OP_PLACE_FUNCTION)) != NULL
+            && interval_evaluate(expr, "x", (Interval){ 0, 1 }, &bounds, &certain) == LISTENERERR_SUCCESS
+            && bounds.lo <= 0 && bounds.hi >= 15;
+        free_tree(expr);
+        set_compensated_evaluation(false);
+        if (!is_equal)
+        {
+            ERROR("Random number was drawn while simplifying for bounds (compensated: %zu)\n", compensated);
+        }
+    }
+    return true;
+}
+
+struct SimplificationTask
+{
+    size_t first_case; // Tasks start at different cases, so that threads simplify different trees at once
+    bool large_sum;    // Expensive, so only done by some tasks
+    bool passed;
+};
+
+// Large sum, so that parallel simplification splits it into tasks for the pool
+static bool simplify_large_sum()
+{
+    char input[1024] = "1*x^1";
+    char expected[1024] = "x";
+    for (size_t i = 2; i <= 50; i++)
+    {
+        sprintf(input + strlen(input), "+1*x^%zu", i);
+        sprintf(expected + strlen(expected), "+x^%zu", i);
+    }
+    Node *tree = parse_easy(g_ctx, input);
+    bool res = tree != NULL && simplify(&tree, NULL) == LISTENERERR_SUCCESS;
+    char *result = res ? tree_to_str(tree, false) : NULL;
+    res = res && strcmp(result, expected) == 0;
+    free(result);
+    free_tree(tree);
+    return res;
+}
+
+static void simplification_task(void *arg)
+{
+    struct SimplificationTask *task = (struct SimplificationTask*)arg;
+    task->passed = !task->large_sum || simplify_large_sum();
+    for (size_t i = 0; i < NUM_CASES && task->passed; i++)
+    {
+        size_t index = (task->first_case + i) % NUM_CASES;
+        Node *left = parse_easy(g_ctx, cases[2 * index]);
+        Node *right = parse_easy(g_ctx, cases[2 * index + 1]);
+        task->passed = simplify(&left, NULL) == LISTENERERR_SUCCESS;
+        if (task->passed && !tree_equals(left, right))
+        {
+            char *left_str = tree_to_str(left, true);
+            char *right_str = tree_to_str(right, true);
+            task->passed = strcmp(left_str, right_str) == 0;
+            free(left_str);
+            free(right_str);
+        }
+        free_tree(left);
+        free_tree(right);
+    }
+}
+
+// Threads simplify concurrently, with and without parallel normalization within each simplification
+static bool check_concurrent(StringBuilder *error_builder)
+{
+    const size_t num_tasks = 8;
+    struct SimplificationTask tasks[8];
+    void *args[8];
+    ThreadPool *pool = pool_create(4);
+    for (size_t parallel = 0; parallel < 2; parallel++)
+    {
+        set_parallel_simplification(parallel);
+        for (size_t i = 0; i < num_tasks; i++)
+        {
+            tasks[i] = (struct SimplificationTask){
+                .first_case = i * NUM_CASES / num_tasks,
+                .large_sum  = parallel && i < 2,
+                .passed     = false
+            };
+            args[i] = tasks + i;
+        }
+        pool_run(pool, simplification_task, num_tasks, args);
+        set_parallel_simplification(false);
+
+        for (size_t i = 0; i < num_tasks; i++)
+        {
+            if (!tasks[i].passed)
+            {
+                pool_destroy(pool);
+                ERROR("Concurrent simplification failed (parallel: %zu)\n", parallel);
+            }
+        }
+    }
+    pool_destroy(pool);
+    return true;
+}
+
+bool simplification_test(StringBuilder *error_builder)
+{
+    if (!simplification_is_initialized())
+    {
+        ERROR("Simplification module initialization failed\n");
+    }
+
+    // Second pass uses normal forms cached in first pass
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        if (!check_cases(NUM_CASES, cases, error_builder)) return false;
+    }
+
+    set_egraph_simplification(true);
+    bool egraph_passed = check_cases(NUM_EGRAPH_CASES, egraph_cases, error_builder);
+    set_egraph_simplification(false);
+    if (!egraph_passed) return false;
+
+    if (!check_wide_rule(error_builder)) return false;
+    if (!check_budget(error_builder)) return false;
+    if (!check_table_derivatives(error_builder)) return false;
+    if (!check_keeping_random(error_builder)) return false;
+    if (!check_concurrent(error_builder)) return false;
 
     // Fuzzer test to detect illegal simplification rules
     /*for (size_t i = 0; i < NUM_FUZZER_CASES; i++)
@@ -6,6 +6,16 @@
 #include "../src/engine/tree/tree_util.h"
 #include "../src/engine/tree/tree_to_string.h"
 
+static ListenerError sum_listener(__attribute__((unused)) const Operator *op,
+    size_t num_children,
+    const double *children,
+    double *out)
+{
+    *out = 0;
+    for (size_t i = 0; i < num_children; i++) *out += children[i];
+    return LISTENERERR_SUCCESS;
+}
+
 bool tree_util_test(StringBuilder *error_builder)
 {
     Operator op = op_get_function("test", OP_DYNAMIC_ARITY);
@@ -98,6 +108,80 @@ bool tree_util_test(StringBuilder *error_builder)
         ERROR("Unexpected replacement by replace_variable_nodes (or tree_copy broken).\n");
     }
 
+    // Case 6
+    // Cached hashes of ancestors need to be invalidated when a descendant is replaced
+    if (get_hash(root) != get_hash(root_copy))
+    {
+        ERROR("Equal trees have different hashes.\n");
+    }
+    tree_replace(get_child_addr(get_child(root_copy, 1), 0), malloc_constant_node(42, 0));
+    if (tree_equals(root_copy, root))
+    {
+        ERROR("Hash of ancestor not invalidated by tree_replace.\n");
+    }
+    tree_replace(get_child_addr(get_child(root_copy, 1), 0), malloc_variable_node("x", 0, 0));
+    if (!tree_equals(root_copy, root))
+    {
+        ERROR("Hash of ancestor not invalidated by tree_replace.\n");
+    }
+
+    // Case 7
+    // Reduction of test(1, test(2, 3), 4) on operand stack
+    Node *reducible = malloc_operator_node(&op, 3, 0);
+    Node *reducible_child = malloc_operator_node(&op, 2, 0);
+    set_child(reducible, 0, malloc_constant_node(1, 0));
+    set_child(reducible, 1, reducible_child);
+    set_child(reducible, 2, malloc_constant_node(4, 0));
+    set_child(reducible_child, 0, malloc_constant_node(2, 0));
+    set_child(reducible_child, 1, malloc_constant_node(3, 0));
+
+    double stack[3];
+    double on_stack_res = 0;
+    double res = 0;
+    if (tree_reduce_stack_size(reducible) != 3
+        || tree_reduce_on_stack(reducible, sum_listener, stack, &on_stack_res, NULL) != LISTENERERR_SUCCESS
+        || tree_reduce(reducible, sum_listener, &res, NULL) != LISTENERERR_SUCCESS
+        || on_stack_res != 10
+        || res != 10)
+    {
+        free_tree(reducible);
+        ERROR("Unexpected result of tree_reduce on operand stack.\n");
+    }
+    free_tree(reducible);
+
+    // Case 8
+    // Maximal constant subtrees of test(x, test(1, 2), test(y, test(3)), test(1, ..., 1)) are reduced
+    Node *mixed = malloc_operator_node(&op, 4, 0);
+    Node *mixed_const = malloc_operator_node(&op, 2, 0);
+    Node *mixed_var = malloc_operator_node(&op, 2, 0);
+    Node *mixed_inner = malloc_operator_node(&op, 1, 0);
+    Node *mixed_wide = malloc_operator_node(&op, 10, 0);
+    set_child(mixed, 0, malloc_variable_node("x", 0, 0));
+    set_child(mixed, 1, mixed_const);
+    set_child(mixed, 2, mixed_var);
+    set_child(mixed, 3, mixed_wide);
+    set_child(mixed_const, 0, malloc_constant_node(1, 0));
+    set_child(mixed_const, 1, malloc_constant_node(2, 0));
+    set_child(mixed_var, 0, malloc_variable_node("y", 0, 0));
+    set_child(mixed_var, 1, mixed_inner);
+    set_child(mixed_inner, 0, malloc_constant_node(3, 0));
+    for (size_t i = 0; i < 10; i++) set_child(mixed_wide, i, malloc_constant_node(1, 0));
+
+    if (tree_reduce_constant_subtrees(&mixed, sum_listener, NULL) != LISTENERERR_SUCCESS
+        || get_type(get_child(mixed, 0)) != NTYPE_VARIABLE
+        || get_type(get_child(mixed, 1)) != NTYPE_CONSTANT
+        || get_const_value(get_child(mixed, 1)) != 3
+        || get_type(get_child(mixed, 2)) != NTYPE_OPERATOR
+        || get_type(get_child(get_child(mixed, 2), 1)) != NTYPE_CONSTANT
+        || get_const_value(get_child(get_child(mixed, 2), 1)) != 3
+        || get_type(get_child(mixed, 3)) != NTYPE_CONSTANT
+        || get_const_value(get_child(mixed, 3)) != 10)
+    {
+        free_tree(mixed);
+        ERROR("Unexpected result of tree_reduce_constant_subtrees.\n");
+    }
+    free_tree(mixed);
+
     free_tree(root);
     free_tree(root_copy);
     free_tree(child_copy);